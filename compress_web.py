@@ -0,0 +1,92 @@
+import gzip
+import hashlib
+import os
+import re
+
+# Gzips the static web UI from web/ into include/WebAssets.h, which builds the
+# files into the firmware as PROGMEM arrays. The firmware serves them with
+# Content-Encoding: gzip, so every firmware-only update (/update, pull OTA,
+# chunked upload, MQTT) carries the UI that matches its pages. A filesystem
+# image is never needed for them; uploading one would replace the config files.
+
+CONTENT_TYPES = {
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".html": "text/html",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+}
+
+
+def asset_symbol(name):
+    parts = re.split(r"[^0-9A-Za-z]+", name)
+    return "webAsset" + "".join(part[:1].upper() + part[1:] for part in parts if part)
+
+
+def render_header(assets):
+    lines = [
+        "// Generated by compress_web.py from web/ - edit those files, not this one",
+        "",
+        "#pragma once",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "struct WebAsset {",
+        "    const char* uri;",
+        "    const char* contentType;",
+        "    const char* etag;           // MD5 of the gzipped bytes",
+        "    const uint8_t* data;        // Gzipped, in flash",
+        "    size_t length;",
+        "};",
+        "",
+    ]
+    for name, symbol, _, _, compressed in assets:
+        lines.append(f"// {name}, {len(compressed)} bytes gzipped")
+        lines.append(f"static const uint8_t {symbol}[] PROGMEM = {{")
+        for start in range(0, len(compressed), 16):
+            row = compressed[start:start + 16]
+            lines.append("    " + ", ".join(f"0x{byte:02x}" for byte in row) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("static const WebAsset webAssets[] = {")
+    for name, symbol, content_type, etag, compressed in assets:
+        lines.append(f'    {{"/{name}", "{content_type}", "\\"{etag}\\"", {symbol}, {len(compressed)}}},')
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def compress_web(project_dir):
+    source_dir = os.path.join(project_dir, "web")
+    header_path = os.path.join(project_dir, "include", "WebAssets.h")
+
+    assets = []
+    for name in sorted(os.listdir(source_dir)):
+        source_path = os.path.join(source_dir, name)
+        if not os.path.isfile(source_path):
+            continue
+
+        with open(source_path, "rb") as f:
+            # mtime=0 keeps the output byte-identical between builds, so ETags stay stable
+            compressed = gzip.compress(f.read(), compresslevel=9, mtime=0)
+        content_type = CONTENT_TYPES.get(os.path.splitext(name)[1], "application/octet-stream")
+        etag = hashlib.md5(compressed).hexdigest()
+        assets.append((name, asset_symbol(name), content_type, etag, compressed))
+
+    header = render_header(assets)
+    if os.path.exists(header_path):
+        with open(header_path, "r") as f:
+            if f.read() == header:
+                return
+
+    with open(header_path, "w") as f:
+        f.write(header)
+    for name, _, _, _, compressed in assets:
+        print(f"Compressed web/{name} into {header_path} ({len(compressed)} bytes)")
+
+try:
+    Import("env")
+    compress_web(env.subst("$PROJECT_DIR"))
+except NameError:
+    # Run directly: python compress_web.py
+    compress_web(os.path.dirname(os.path.abspath(__file__)))
@@ -0,0 +1,206 @@
+// Event-driven HTTP server on raw lwIP callbacks with a fixed pool of connections.
+// It mirrors the part of the ESP8266WebServer API used by setupWebServer() and its
+// handlers, so the route table builds unchanged against either server.
+
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>   // HTTPMethod, HTTPUpload and CONTENT_LENGTH_UNKNOWN
+
+struct tcp_pcb;
+struct pbuf;
+
+#define HTTP_MAX_CONNECTIONS 4          // Further clients get a 503 and are closed
+#define HTTP_CONNECTION_BUFFER 1536     // Request line, headers and non-upload body per connection
+#define HTTP_MAX_ARGS 24
+#define HTTP_MAX_ROUTES 28
+#define HTTP_REQUEST_TIMEOUT_MS 10000   // Drop clients that stop sending mid-request
+#define HTTP_WRITE_TIMEOUT_MS 5000      // Give up on clients that stop reading the response
+#define HTTP_EXTRA_HEADERS 192         // Room for headers a handler adds with sendHeader()
+#define HTTP_LOOP_BUDGET_US 5000        // Time one handleClient() call may spend, the rest waits a pass
+
+class AsyncHttpServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+    // Fills up to size bytes of the response body, returns 0 once it is complete
+    typedef std::function<size_t(uint8_t* buffer, size_t size)> TContentSource;
+
+    explicit AsyncHttpServer(uint16_t port);
+
+    void begin();
+
+    // Parses what the lwIP callbacks have received, runs handlers and feeds pending
+    // responses - call from loop(). Stops once budgetUs is spent and carries on from
+    // there on the next call, so a long page or an upload never holds up the loop.
+    void handleClient(uint32_t budgetUs = HTTP_LOOP_BUDGET_US);
+
+    AsyncHttpServer& on(const char* uri, THandlerFunction handler);
+    AsyncHttpServer& on(const char* uri, HTTPMethod method, THandlerFunction handler);
+    AsyncHttpServer& on(const char* uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler);
+
+    // Request, valid inside a handler
+    bool hasArg(const char* name) const;
+    String arg(const char* name) const;
+    String header(const char* name) const;     // Only Content-Type and If-None-Match are kept
+    HTTPUpload& upload() { return _upload; }
+
+    // Response, same semantics as ESP8266WebServer
+    void setContentLength(size_t length) { _contentLength = length; }
+    void sendHeader(const char* name, const char* value);      // Before send(), dropped if they don't fit
+    void send(int code, const char* contentType, const char* content);
+    void send(int code, const char* contentType, const String& content);
+    void sendContent(const char* content, size_t length);
+    void sendContent(const char* content) { sendContent(content, strlen(content)); }
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+    void sendContent_P(PGM_P content, size_t length);
+    void sendContent_P(PGM_P content) { sendContent_P(content, strlen_P(content)); }
+    Print& client() { return _writer; }
+    // Rest of the body comes from source, called across later handleClient() passes
+    // as the client takes data. It outlives the handler, so it must not refer to the
+    // handler's locals or the request arguments.
+    void sendContentSource(TContentSource source);
+
+    // Long-lived responses such as server-sent events. Called from a handler after
+    // it has written its headers, this keeps the connection open once the handler
+    // returns. The handle stays valid until the stream closes, 0 means no stream.
+    uint16_t detachStream();
+    bool streamWrite(uint16_t handle, const char* data, size_t length);   // false if closed or too slow
+    bool streamConnected(uint16_t handle) const;
+    void streamClose(uint16_t handle);
+
+    // Pool usage for the status pages
+    uint8_t activeConnections() const;
+    uint32_t rejectedConnections() const { return _rejected; }
+
+private:
+    enum ConnectionState : uint8_t {
+        CONN_FREE,
+        CONN_HEAD,      // Reading request line and headers
+        CONN_BODY,      // Reading a body into the connection buffer
+        CONN_UPLOAD,    // Streaming a multipart body through the upload handler
+        CONN_READY,     // Complete, waiting for its handler
+        CONN_RESPOND,   // Handler done, body still coming from its content source
+        CONN_STREAM     // Detached by its handler, written to through the stream calls
+    };
+
+    enum MultipartState : uint8_t {
+        PART_DATA,
+        PART_DELIMITER_TAIL,
+        PART_HEADERS,
+        PART_DONE
+    };
+
+    struct Arg {
+        const char* name;
+        const char* value;
+    };
+
+    struct Connection {
+        tcp_pcb* pcb;
+        pbuf* rx;                   // Received but not yet parsed, acknowledged as it is consumed
+        uint16_t rxOffset;
+        ConnectionState state;
+        bool peerClosed;
+        bool failed;                // lwIP reported an error, pcb is already gone
+        uint8_t generation;         // Bumped on every accept, makes stream handles unique
+        uint32_t lastActivity;
+
+        char buf[HTTP_CONNECTION_BUFFER];
+        uint16_t len;
+        uint16_t headLength;        // Bytes of buf taken by the parsed head
+        size_t bodyRemaining;
+
+        HTTPMethod method;
+        bool http10;
+        const char* uri;
+        const char* contentType;
+        const char* ifNoneMatch;
+        Arg args[HTTP_MAX_ARGS];
+        uint8_t argCount;
+        int8_t route;               // Index into _routes, -1 when none matched
+
+        // Response fed from a content source, buf holds the piece lwIP has not taken yet
+        TContentSource source;
+        bool chunked;
+        uint16_t pendingStart;
+        uint16_t pendingLength;
+
+        // Multipart upload
+        MultipartState partState;
+        char delimiter[76];         // "\r\n--" + boundary
+        uint8_t delimiterLength;
+        uint8_t delimiterMatched;
+        uint16_t lineLength;        // Part header line being collected past len
+        bool partIsFile;
+        const char* partName;       // Non-file part: name, value is collected into buf
+        char* partValue;
+    };
+
+    struct Route {
+        const char* uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+        THandlerFunction uploadHandler;
+    };
+
+    // Raw writes to the current connection, waits for the send buffer when full
+    class Writer : public Print {
+    public:
+        explicit Writer(AsyncHttpServer& server) : _server(server) {}
+        size_t write(uint8_t c) override { return _server.writeRaw(&c, 1); }
+        size_t write(const uint8_t* data, size_t size) override { return _server.writeRaw(data, size); }
+    private:
+        AsyncHttpServer& _server;
+    };
+
+    static int8_t onAccept(void* arg, tcp_pcb* pcb, int8_t err);
+    static int8_t onReceive(void* arg, tcp_pcb* pcb, pbuf* p, int8_t err);
+    static void onError(void* arg, int8_t err);
+
+    void consume(Connection& c);
+    bool feedHead(Connection& c, const char* data, size_t length, size_t& used);
+    bool parseHead(Connection& c);
+    void feedBody(Connection& c, const char* data, size_t length, size_t& used);
+    void feedMultipart(Connection& c, const char* data, size_t length, size_t& used);
+    void multipartByte(Connection& c, uint8_t b);
+    void partByte(Connection& c, uint8_t b);
+    void multipartHeaderLine(Connection& c, char* line);
+    void beginPart(Connection& c);
+    void endPart(Connection& c);
+    void parseArgs(Connection& c, char* text);
+    bool addArg(Connection& c, const char* name, const char* value);
+
+    void dispatch(Connection& c);
+    void pump(Connection& c);
+    bool sliceExpired() const { return micros() - _sliceStart >= _sliceBudget; }
+    void sendError(Connection& c, int code, const char* message);
+    void sendHeaders(int code, const char* contentType, size_t contentLength, const char* extraHeaders);
+    void writeBody(const uint8_t* data, size_t length);
+    size_t writeRaw(const uint8_t* data, size_t length);
+    void finishResponse();
+    void release(Connection& c, bool graceful);
+    Connection* streamConnection(uint16_t handle) const;
+
+    uint16_t _port;
+    tcp_pcb* _listener;
+    Connection _pool[HTTP_MAX_CONNECTIONS];
+    Route _routes[HTTP_MAX_ROUTES];
+    uint8_t _routeCount;
+    uint32_t _rejected;
+
+    // Time slice of the current handleClient() call
+    uint32_t _sliceStart;
+    uint32_t _sliceBudget;
+    uint8_t _nextSlot;          // Where the next pass starts, so no connection starves
+
+    // Current response
+    Connection* _current;
+    size_t _contentLength;
+    char _extraHeaders[HTTP_EXTRA_HEADERS];
+    uint16_t _extraHeadersLength;
+    bool _headersSent;
+    bool _chunked;
+    bool _responseEnded;
+    Writer _writer;
+    HTTPUpload _upload;
+};
@@ -0,0 +1,41 @@
+// Boot-phase profiler: times each phase of setup() and keeps the last few boots on flash
+
+#pragma once
+
+#include <Arduino.h>
+
+// Phases of setup() in the order they run
+enum BootPhase : uint8_t {
+    BOOT_PHASE_DISPLAY,     // MAX7219 display init
+    BOOT_PHASE_FS,          // LittleFS mount
+    BOOT_PHASE_WIFI,        // WiFiManager connect / portal and mDNS
+    BOOT_PHASE_OTA,         // ArduinoOTA init
+    BOOT_PHASE_CONFIG,      // Loading the JSON config files
+    BOOT_PHASE_TIME,        // setupTime()
+    BOOT_PHASE_WEBSERVER,   // setupWebServer()
+    BOOT_PHASE_NTFY,        // ntfy.sh connect notification
+    BOOT_PHASE_MQTT,        // setupMQTT()
+    BOOT_PHASE_COUNT
+};
+
+#define BOOT_PROFILE_HISTORY 8                  // Number of boots kept on flash
+#define BOOT_PROFILE_FILE "/boot_profile.bin"
+
+struct BootRecord {
+    uint16_t magic;                         // Guards against records from a different layout
+    uint8_t phase_count;
+    uint8_t reserved;
+    uint32_t sequence;                      // Increments on every boot
+    float version;                          // Firmware version that produced this record
+    uint32_t total_us;                      // Whole of setup()
+    uint32_t phase_us[BOOT_PHASE_COUNT];    // Duration of each phase, 0 if it did not run
+};
+
+void bootProfileStart();                // Call first thing in setup()
+void bootPhaseBegin(BootPhase phase);
+void bootPhaseEnd(BootPhase phase);
+void bootProfileFinish();               // Call at the end of setup(), persists the record
+
+const char* bootPhaseName(BootPhase phase);
+void printBootProfile(Print& out);      // Telnet "boot" command
+void handleBootProfile();               // GET /api/boot
@@ -0,0 +1,52 @@
+// Fixed-size write buffer in front of a client, so byte-wise writers such as
+// ArduinoJson go out in TCP-sized pieces without building a String first
+
+#pragma once
+
+#include <Arduino.h>
+
+template <size_t N>
+class BufferedPrint : public Print {
+public:
+    explicit BufferedPrint(Print& target) : _target(target), _len(0) {}
+
+    ~BufferedPrint() {
+        flush();
+    }
+
+    size_t write(uint8_t c) override {
+        if (_len == N) {
+            flush();
+        }
+        _buf[_len++] = c;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t remaining = size;
+        while (remaining > 0) {
+            if (_len == N) {
+                flush();
+            }
+            size_t n = N - _len;
+            if (n > remaining) n = remaining;
+            memcpy(_buf + _len, data, n);
+            _len += n;
+            data += n;
+            remaining -= n;
+        }
+        return size;
+    }
+
+    void flush() override {
+        if (_len > 0) {
+            _target.write(_buf, _len);
+            _len = 0;
+        }
+    }
+
+private:
+    Print& _target;
+    uint8_t _buf[N];
+    size_t _len;
+};
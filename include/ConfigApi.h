@@ -0,0 +1,34 @@
+// JSON configuration API for fleet tooling and the static UI
+
+#pragma once
+
+#include <ArduinoJson.h>
+
+#define CONFIG_BUNDLE_VALUE_MAX 768     // Largest single section an imported bundle may have
+
+// GET /api/config - streams device, display, time, mqtt, firmware and notify sections
+void handleConfigGet();
+
+// PATCH /api/config - partial update, validated as a whole before anything is applied
+void handleConfigPatch();
+
+// Writes the current configuration into doc (MQTT password is never exported)
+void buildConfigJson(JsonDocument& doc);
+
+// Validates every field present in root and only then applies them to the live config.
+// Returns false with a message in error if anything is invalid; changedSections gets
+// the ConfigSection bits of what actually changed.
+bool applyConfigJson(JsonObjectConst root, uint8_t& changedSections, String& error);
+
+// Full configuration for provisioning: everything in buildConfigJson plus the MQTT
+// password and the system command
+void buildConfigBundle(JsonDocument& doc);
+
+// GET /api/config/bundle - the bundle as a download
+void handleConfigBundleExport();
+
+// POST /api/config/bundle - a bundle as a JSON body or an uploaded file. Sections
+// are parsed as they arrive, nothing is applied unless the whole bundle is valid,
+// and then every change goes into one config commit.
+void handleConfigBundleImport();
+void handleConfigBundleUpload();        // Upload handler for the same route
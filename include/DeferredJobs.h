@@ -0,0 +1,21 @@
+// Side effects that HTTP handlers hand off to loop() so their response goes out first
+
+#pragma once
+
+#include <Arduino.h>
+
+#define DEFERRED_MAX_JOBS 6
+#define DEFERRED_RESPONSE_GRACE_MS 500  // Lets a reply drain before a job that restarts the clock
+
+typedef void (*DeferredJob)();
+
+// Run job from loop() once delayMs has passed. A job that is already queued is not
+// queued again, so several saves in a row still reconnect only once. Returns false
+// (and runs nothing) when the queue is full.
+bool deferJob(DeferredJob job, uint32_t delayMs = 0);
+
+// Runs the jobs that are due - call from loop() after server.handleClient()
+void runDeferredJobs();
+
+extern uint32_t deferredJobsRun;
+extern uint32_t deferredJobsDropped;
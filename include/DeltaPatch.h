@@ -0,0 +1,69 @@
+// Streaming applier for firmware.delta: rebuilds the new image into the update partition
+// from the running firmware plus the patch, format as written by move_firmware.py
+
+#pragma once
+
+#include <Arduino.h>
+#include <bearssl/bearssl_hash.h>
+
+#define DELTA_HEADER_SIZE 76
+#define DELTA_CHUNK_SIZE 512            // Flash read and hashed per step()
+
+class DeltaPatch {
+public:
+    DeltaPatch();
+
+    // Takes patch bytes and returns how many it used. Stops early while busy(),
+    // hand the rest back once step() has caught up.
+    size_t feed(const uint8_t* data, size_t length);
+
+    // Flash work is done in small steps so loop() keeps running: checking the
+    // running image against the patch base, then every COPY operation
+    bool busy() const;
+    void step();
+
+    bool failed() const { return _state == FAILED; }
+    bool complete() const { return _state == COMPLETE; }
+    const char* error() const { return _error; }
+    uint32_t written() const { return _written; }
+    uint32_t imageSize() const { return _newSize; }
+    const uint8_t* imageHash() const { return _header + 44; }  // SHA-256 the result must have
+
+private:
+    enum State : uint8_t {
+        HEADER,
+        VERIFY_BASE,    // Hashing the running image, busy
+        OP,
+        COPY_OFFSET,
+        COPY_LENGTH,
+        COPYING,        // Busy
+        INSERT_LENGTH,
+        INSERTING,
+        COMPLETE,
+        FAILED
+    };
+
+    void fail(const char* message);
+    bool readVarint(uint8_t byte);
+    bool output(const uint8_t* data, size_t length);
+    void nextOp();
+
+    State _state;
+    const char* _error;
+
+    uint8_t _header[DELTA_HEADER_SIZE];
+    uint8_t _headerLength;
+    uint32_t _oldSize;
+    uint32_t _newSize;
+
+    uint32_t _varint;
+    uint8_t _varintShift;
+    int32_t _copyDelta;
+    uint32_t _copyOffset;
+    uint32_t _copyEnd;          // Old image offset just past the previous copy
+    uint32_t _remaining;        // Of the current copy, insert or base check
+
+    uint32_t _written;
+    br_sha256_context _hash;
+    uint8_t _chunk[DELTA_CHUNK_SIZE];
+};
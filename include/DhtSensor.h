@@ -0,0 +1,40 @@
+// Non-blocking DHT22 driver: the response is captured by GPIO edge interrupts and
+// decoded on a later loop() pass, nothing waits on the sensor with interrupts off
+
+#pragma once
+
+#include <Arduino.h>
+
+#define DHT_START_LOW_MS 2              // Host start signal, the DHT22 takes 0.8 to 20 ms
+#define DHT_RESPONSE_TIMEOUT_MS 15      // From dhtStart() until all 40 bits must be in, about 7 ms when it works
+#define DHT_RESPONSE_EDGES 83           // Response low/high, then a rising and a falling edge per bit
+#define DHT_MAX_EDGES 88                // Room for a few extra edges, they are ignored
+#define DHT_ONE_THRESHOLD_US 48         // Bit high time: 26-28 us is a 0, 70 us a 1
+
+enum DhtStatus : uint8_t {
+    DHT_IDLE,
+    DHT_BUSY,               // Conversion running, poll again on the next pass
+    DHT_OK,                 // dhtTemperature() and dhtHumidity() hold the new reading
+    DHT_CHECKSUM_ERROR,
+    DHT_TIMEOUT             // No response, or it stopped short of 40 bits
+};
+
+void dhtBegin(uint8_t pin);
+
+// Sends the start signal, the line is released from a timer. False while a
+// conversion is still running. The DHT22 needs 2 s between conversions.
+bool dhtStart();
+
+// Call from loop(): DHT_BUSY until the response is in or timed out, then the
+// result once, DHT_IDLE after that
+DhtStatus dhtPoll();
+
+float dhtTemperature();     // Celsius
+float dhtHumidity();        // Percent
+
+extern uint32_t dhtChecksumFailures;
+extern uint32_t dhtTimeouts;
+extern uint32_t dhtResponseUs;      // Start signal released to the last bit, latest read
+extern uint32_t dhtCpuUs;           // loop() time spent starting and decoding the latest read
+extern uint8_t dhtZeroHighMaxUs;    // Longest 0 bit and shortest 1 bit of the latest good read,
+extern uint8_t dhtOneHighMinUs;     // how much margin DHT_ONE_THRESHOLD_US has
@@ -0,0 +1,11 @@
+// Heap low-water mark, sampled wherever request handling holds the most memory
+
+#pragma once
+
+#include <Arduino.h>
+
+void sampleHeap();                  // Cheap, call from loop() and from response writers
+uint32_t getHeapLowWater();         // Smallest free heap seen since boot or the last reset
+void resetHeapLowWater();
+
+void handleHeapStats();             // GET /api/heap, ?reset=1 starts a new low-water window
@@ -0,0 +1,20 @@
+// Live dashboard: pushes readings, intensity, time and the rotation item to
+// browsers over Server-Sent Events as they change
+
+#pragma once
+
+#include <Arduino.h>
+
+#define LIVE_MAX_SUBSCRIBERS 2          // Each one holds a TCP connection open
+#define LIVE_KEEPALIVE_MS 15000         // Comment line that also detects dead subscribers
+
+void handleLiveSubscribe();             // GET /api/live
+void handleLiveEvents();                // Keepalives and pruning - call from loop()
+
+// Each pushes a small event to all subscribers, but only when the value changed
+void liveUpdateReading(float temperature, float humidity);
+void liveUpdateIntensity(int intensity);
+void liveUpdateDisplayItem(uint8_t item);   // 1 = date, 2 = temperature, 3 = humidity
+void liveUpdateTime(const char* timeText);
+
+uint8_t getLiveSubscriberCount();
@@ -0,0 +1,21 @@
+// Prometheus /metrics endpoint: device, sensor, network and HTTP counters in text exposition format
+
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>   // HTTPMethod
+
+#define METRICS_BUFFER_SIZE 512         // The whole response goes through this, in chunks
+#define METRICS_MAX_ROUTES 28
+
+void setupMetrics();                    // Call early in setup(), before WiFi connects
+void handleMetrics();                   // GET /metrics
+
+// Time since the previous call - call first thing in loop()
+void recordLoopPass();
+
+// One DHT temperature and humidity read, ok when both values were valid
+void recordDhtRead(bool ok, uint32_t durationUs);
+
+// Wraps a route handler so its requests are counted per route and method
+std::function<void(void)> countRequests(const char* uri, HTTPMethod method, std::function<void(void)> handler);
@@ -0,0 +1,27 @@
+// Firmware delivery over the MQTT session the clock already holds, for networks
+// where nothing can reach its web server
+
+#pragma once
+
+#include <Arduino.h>
+
+#define MQTT_OTA_CHUNK_SIZE 1024            // Image bytes per chunk message
+#define MQTT_OTA_WINDOW 8                   // Chunks the sender may have unacknowledged
+#define MQTT_OTA_PACKET_SIZE 1200           // PubSubClient buffer while an update runs: chunk, header and topic
+#define MQTT_OTA_TIMEOUT_MS 60000           // Give up when no chunk arrives for this long
+
+// Topics under homeassistant/<hostname>/ota/:
+//   begin  {"size": N, "sha256": "..."} starts (or restarts) an update
+//   chunk  sequence number (u32, little endian) then up to MQTT_OTA_CHUNK_SIZE bytes
+//   abort  drops the update
+//   ack    published by the clock: {"state", "next", "window", "chunk", "error"}.
+//          next is the sequence number it wants; acks come at the start, after
+//          every window, on a gap or duplicate, and at the end. The image is
+//          checked against sha256 before the clock restarts into it.
+void subscribeMqttOta();
+
+// From the MQTT callback: true if the message was for the OTA topics
+bool handleMqttOtaMessage(const char* topic, const uint8_t* payload, unsigned int length);
+
+// Publishes pending acks and expires a stalled update - call from loop()
+void handleMqttOta();
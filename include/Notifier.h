@@ -0,0 +1,26 @@
+// Background outbound notifications (ntfy.sh or an internal endpoint) with a bounded queue
+
+#pragma once
+
+#include <Arduino.h>
+
+#define NOTIFY_QUEUE_SIZE 4                 // Messages waiting to be delivered
+#define NOTIFY_MESSAGE_SIZE 128
+#define NOTIFY_MAX_ATTEMPTS 5               // Give up on a message after this many failures
+#define NOTIFY_CONNECT_TIMEOUT_MS 1500      // DNS lookup and TCP connect, each
+#define NOTIFY_RESPONSE_TIMEOUT_MS 3000     // Waiting for the status line
+#define NOTIFY_RETRY_BASE_MS 5000           // First retry delay, doubled on every failure
+#define NOTIFY_RETRY_MAX_MS 300000
+
+// Queue a plain text message for POSTing to the notify endpoint.
+// Returns false (and counts a drop) when the queue is full.
+bool notifyEnqueue(const char* message);
+
+// Advance the delivery state machine - call from loop(). The DNS lookup and the
+// response never block, the TCP connect holds up one pass at most
+// NOTIFY_CONNECT_TIMEOUT_MS.
+void handleNotifier();
+
+extern uint32_t notifySent;      // Delivered with a 2xx response
+extern uint32_t notifyFailed;    // Given up after NOTIFY_MAX_ATTEMPTS
+extern uint32_t notifyDropped;   // Rejected because the queue was full
@@ -0,0 +1,67 @@
+// Pull OTA: the clock checks manifest.json next to firmwareConfig.update_url, downloads
+// newer firmware itself when asked to and streams it straight into the update
+// partition from loop()
+
+#pragma once
+
+#include <Arduino.h>
+
+#define OTA_BUFFER_SIZE 1024
+#define OTA_CONNECT_TIMEOUT_MS 3000         // DNS lookup and TCP connect, each
+#define OTA_STALL_TIMEOUT_MS 15000          // Give up when the server sends nothing for this long
+#define OTA_PASS_BUDGET_MS 20               // Flash writing per loop() pass, the clock keeps running
+#define OTA_PROGRESS_INTERVAL_MS 500        // Display refresh during any firmware write
+#define OTA_FIRST_CHECK_MS 600000UL         // First manifest check after boot
+#define OTA_CHECK_INTERVAL_MS 21600000UL    // Then every 6 hours
+
+enum OtaState : uint8_t {
+    OTA_IDLE,
+    OTA_RESOLVING,
+    OTA_CONNECTING,
+    OTA_HEADERS,
+    OTA_DOWNLOADING,
+    OTA_FAILED
+};
+
+// Makes Update check the signature of every image, whichever way it arrives,
+// when the firmware has a key from update_signing.py - call once in setup()
+void setupUpdateSigning();
+bool isUpdateSigningEnabled();
+
+// Update from an http:// or https:// url. manifest.json in the same directory
+// comes first: without force it is only a check, a newer version is downloaded
+// when firmwareConfig.auto_update is set and otherwise just reported by
+// /api/ota. Its SHA-256 is checked before the image is committed. Then
+// firmware.delta is tried if the manifest lists it (or there is no manifest),
+// with the full image as the fallback for anything that goes wrong with it.
+// The server certificate isn't checked, without a signing key the image comes
+// from whoever answers. Returns nullptr once started, otherwise why not.
+const char* startPullOta(const char* url, bool force);
+
+// Advance the update and run the periodic manifest check - call from loop().
+// Restarts the clock once a new image is in. The DNS lookup runs in the
+// background, the TCP connect and an https handshake still hold up one pass.
+void handlePullOta();
+
+// True while firmware is downloading
+bool isPullOtaRunning();
+
+// Progress of a pushed update, /update or ArduinoOTA. Each chunk reports in, the
+// display is redrawn at most every OTA_PROGRESS_INTERVAL_MS and the end logs the
+// throughput. total is 0 when the size isn't known. These callbacks run inside
+// server.handleClient() and ArduinoOTA.handle() for the whole upload, so each
+// report also gives the time display its tick.
+void beginOtaProgress(const char* source);
+void reportOtaProgress(uint32_t done, uint32_t total);
+void endOtaProgress(bool ok);
+
+// Any firmware being written: progress owns the second display meanwhile
+bool isOtaInProgress();
+
+// 64 hex digits into 32 bytes, false if hex isn't a SHA-256
+bool parseSha256(const char* hex, uint8_t* out);
+
+// GET /api/ota - state, versions and whether the latest one is newer, whether
+// the image is checked against the manifest and verified by its signature,
+// bytes so far, image size and throughput
+void handleOtaStatus();
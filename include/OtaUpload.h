@@ -0,0 +1,23 @@
+// Resumable firmware upload: the image arrives as CRC-checked chunks at explicit
+// offsets, and the device keeps the committed offset across dropped connections
+
+#pragma once
+
+#include <Arduino.h>
+
+#define OTA_UPLOAD_CHUNK_MAX 4096            // One flash sector, held in RAM until its CRC checks out
+#define OTA_UPLOAD_IDLE_TIMEOUT_MS 600000UL  // Abandoned sessions give up the update partition
+
+// GET /api/ota/upload - {"active", "offset", "done", "size", "image"}, where a client resumes
+void handleOtaUploadStatus();
+
+// POST /api/ota/upload?offset=N&size=TOTAL&crc=CHUNK&image=IMAGE, one chunk as a
+// multipart file part. CRCs are CRC-32 (zlib) in hex, image covers the whole file.
+// offset=0 starts a new session, anything else must equal the committed offset.
+// A chunk is written to flash only when its CRC matches; the last one also has to
+// complete the image CRC, then the clock restarts into it.
+void handleOtaUploadDone();
+void handleOtaUploadData();              // Upload handler for the same route
+
+// Drops a session nobody has sent to for OTA_UPLOAD_IDLE_TIMEOUT_MS - call from loop()
+void handleOtaUpload();
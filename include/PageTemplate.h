@@ -0,0 +1,29 @@
+// Streams HTML templates from flash, filling {{placeholder}} slots through a callback
+
+#pragma once
+
+#include <Arduino.h>
+
+#define TEMPLATE_CHUNK_SIZE 512     // Largest chunk written by ESP8266WebServer
+#define TEMPLATE_MAX_NAME 24        // Longest placeholder name, including the terminator
+#define TEMPLATE_MAX_STREAMS 2      // ESP8266WebServer: pages sent from loop() at once, more render in their handler
+#define TEMPLATE_PASS_BUDGET_US 5000    // Time one page may take per loop() pass, as HTTP_LOOP_BUDGET_US
+#define TEMPLATE_MIN_ROOM 64        // Smaller send buffer room than this waits for the next pass
+#define TEMPLATE_WRITE_TIMEOUT_MS 5000  // Give up on clients that stop reading
+
+// Called once per placeholder with its name; print the value to out
+typedef std::function<void(Print& out, const char* name)> TemplateFiller;
+
+// Sends a text/html response for a PROGMEM template. Heap use does not depend on
+// the page size: the page is rendered a chunk at a time and only a value that
+// straddles two chunks is held over. Chunks are rendered as the client takes
+// them, possibly after the handler has returned, so fill must not refer to the
+// handler's locals or request arguments.
+void sendTemplate(int code, PGM_P page, const TemplateFiller& fill);
+
+// Sends pages that didn't fit the handler's slice, within TEMPLATE_PASS_BUDGET_US
+// each - call from loop() after server.handleClient()
+void handleTemplateStreams();
+
+// For values inside attributes and text: escapes & < > ' "
+void printHtmlEscaped(Print& out, const char* text);
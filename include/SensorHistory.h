@@ -0,0 +1,32 @@
+// The last 24 hours of temperature and humidity at one-minute resolution, kept in
+// RAM as fixed-point deltas and streamed by /api/history
+
+#pragma once
+
+#include <Arduino.h>
+
+#define HISTORY_SLOTS 1440              // One-minute samples, 4 bytes each
+#define HISTORY_INTERVAL_MS 60000
+#define HISTORY_SCALE 100               // Fixed point: hundredths of a degree Celsius and of a percent
+#define HISTORY_LIMIT 16000             // Values are clamped to +-160.00, so every delta fits an int16
+#define HISTORY_GAP INT16_MIN           // Delta of a minute without a good reading
+#define HISTORY_CHUNK_SIZE 512          // Largest chunk written by ESP8266WebServer
+
+// Every good sensor reading, after calibration. Each minute stores their average.
+void recordHistoryReading(float celsius, float humidity);
+
+// Closes the minute, missed ones become gaps - call from loop()
+void updateSensorHistory();
+
+// GET /api/history, oldest sample first. ?minutes=N limits it to the newest N.
+//   CSV (default): time,temperature_c,humidity - time is the Unix time at the
+//     end of the minute, or age_s (seconds before now) while the clock isn't
+//     set. A gap has empty fields.
+//   ?format=bin, little endian:
+//     "DCH1", u16 sample count, u16 interval in seconds, u32 Unix time at the
+//     end of the newest minute (0 while the clock isn't set), i16 temperature
+//     and i16 humidity before the first sample, then per sample an i16
+//     temperature and an i16 humidity delta in HISTORY_SCALE units.
+//     HISTORY_GAP leaves the value unchanged. A response still being sent
+//     when a minute overwrites its next sample ends there, short of the count.
+void handleHistory();
@@ -0,0 +1,50 @@
+// Event-driven SNTP: clock validity and sync history come from the core's settimeofday callback
+
+#pragma once
+
+#include <Arduino.h>
+
+#define NTP_SERVER_1 "pool.ntp.org"
+#define NTP_SERVER_2 "time.nist.gov"
+#define TIME_SYNC_HISTORY 8                           // Sync events kept in RAM
+
+// Adaptive sync interval: sync just often enough that the residual drift stays under
+// NTP_TARGET_ERROR_MS, given how noisy this oscillator's drift has been
+#define NTP_MIN_SYNC_INTERVAL_MS (3600UL * 1000UL)        // Also used until drift is known
+#define NTP_MAX_SYNC_INTERVAL_MS (72UL * 3600UL * 1000UL)
+#define NTP_TARGET_ERROR_MS 250
+#define NTP_MIN_DRIFT_WINDOW_MS (15UL * 60UL * 1000UL)   // Shorter windows are dominated by network jitter
+#define NTP_DRIFT_SMOOTHING 0.3f                         // EWMA weight of a new drift sample
+#define NTP_INITIAL_NOISE_PPM 20.0f                      // Assume a poor crystal until shown otherwise
+#define NTP_SLEW_INTERVAL_MS 10000                       // How often the drift correction is applied
+
+struct TimeSyncEvent {
+    time_t time;          // UTC seconds right after the sync
+    int32_t offset_ms;    // Residual error NTP corrected after our slewing, 0 when initial
+    float drift_ppm;      // Drift estimate after this sync
+    bool initial;         // First sync since boot or since a manual time set
+    char server[24];      // Configured primary server
+};
+
+// Starts SNTP and returns immediately, the callback takes it from there
+void setupTime();
+
+// Puts a changed timeConfig.timezone_offset into effect, run as a deferred job
+void applyTimezone();
+
+// Slews the clock by the estimated drift between syncs - call from loop()
+void handleTimeSync();
+
+// True once SNTP or a manual set has given us a real clock
+bool isTimeSet();
+
+// Number of SNTP syncs since boot and access to the most recent ones (0 = newest)
+uint32_t getTimeSyncCount();
+const TimeSyncEvent* getTimeSyncEvent(uint8_t age);
+
+// Current drift estimate and the interval it gave for the next SNTP poll
+float getClockDriftPpm();
+uint32_t getNtpSyncIntervalMs();
+
+void printTimeSyncEvents(Print& out);   // Telnet "ntp" command
+void handleTimeSyncStatus();            // GET /api/ntp
@@ -0,0 +1,5 @@
+// Generated by update_signing.py from public.key - edit that file, not this one
+
+#pragma once
+
+// No public.key: update images aren't signed or checked
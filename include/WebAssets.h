@@ -0,0 +1,112 @@
+// Generated by compress_web.py from web/ - edit those files, not this one
+
+#pragma once
+
+#include <Arduino.h>
+
+struct WebAsset {
+    const char* uri;
+    const char* contentType;
+    const char* etag;           // MD5 of the gzipped bytes
+    const uint8_t* data;        // Gzipped, in flash
+    size_t length;
+};
+
+// config.js, 820 bytes gzipped
+static const uint8_t webAssetConfigJs[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x95, 0x55, 0x5d, 0x4f, 0xdb, 0x30,
+    0x14, 0x7d, 0xef, 0xaf, 0xb8, 0x7b, 0x18, 0x49, 0x06, 0xa4, 0xb0, 0x07, 0x1e, 0x60, 0x1d, 0x1a,
+    0x1f, 0xd3, 0x3a, 0xc1, 0x8a, 0xd4, 0xbd, 0x4c, 0x08, 0x21, 0x37, 0xbe, 0x4d, 0xac, 0xa6, 0x76,
+    0x15, 0x3b, 0xfd, 0xd8, 0xd4, 0xff, 0xbe, 0xeb, 0x38, 0x69, 0x02, 0x69, 0x8b, 0x40, 0x42, 0xae,
+    0xed, 0x73, 0x8e, 0xef, 0x3d, 0xbe, 0xb9, 0x1e, 0xe7, 0x32, 0x32, 0x42, 0x49, 0xd0, 0x68, 0xae,
+    0xf3, 0x2c, 0x43, 0x69, 0x6e, 0x98, 0xc1, 0xdf, 0x62, 0x8a, 0x7e, 0x00, 0xff, 0x3a, 0x00, 0x91,
+    0x92, 0xda, 0x80, 0x54, 0x0b, 0xe8, 0x81, 0xc4, 0x05, 0xd8, 0x6d, 0x3f, 0xb8, 0xa0, 0x1d, 0xae,
+    0xa2, 0x7c, 0x4a, 0x84, 0x30, 0x46, 0x73, 0x9b, 0xa2, 0xfd, 0x79, 0xb5, 0xea, 0x73, 0xdf, 0x5b,
+    0x21, 0xcb, 0xbc, 0x20, 0x9c, 0xb3, 0x34, 0x47, 0xcb, 0x52, 0x0b, 0x0b, 0xf9, 0x9e, 0xa7, 0xe9,
+    0x1f, 0xda, 0x79, 0x83, 0x3c, 0x55, 0xd2, 0x24, 0x6d, 0xf6, 0xbd, 0x5d, 0xa6, 0x90, 0x0e, 0xe1,
+    0x74, 0x2f, 0x9d, 0xb3, 0x55, 0x9b, 0x5c, 0xc7, 0x9c, 0xa2, 0x81, 0x44, 0xe5, 0x99, 0xae, 0x37,
+    0x7f, 0xd8, 0xa9, 0xdb, 0x75, 0xb9, 0xb2, 0xe9, 0x6c, 0x4a, 0xdb, 0x0e, 0xf6, 0xb5, 0x07, 0xa7,
+    0x9f, 0xe1, 0x12, 0xbc, 0x07, 0x0f, 0xce, 0xc1, 0xfb, 0xe6, 0x59, 0x5c, 0xa5, 0xe0, 0xc6, 0x8f,
+    0x84, 0x68, 0xaf, 0x5e, 0x96, 0xe3, 0x79, 0xb9, 0xbb, 0x33, 0x62, 0x0b, 0x6b, 0x84, 0x5c, 0xb0,
+    0xf6, 0x3b, 0x24, 0x64, 0x6e, 0x70, 0x8b, 0x45, 0xc5, 0x7a, 0x2b, 0x95, 0x21, 0xa6, 0x18, 0x19,
+    0x82, 0xed, 0x14, 0xb4, 0x28, 0xaf, 0x60, 0x8d, 0x55, 0x06, 0xbe, 0xf5, 0x48, 0x10, 0xfe, 0xe4,
+    0x82, 0x86, 0x2f, 0x0d, 0x8d, 0x50, 0xcd, 0x6c, 0xad, 0xe8, 0x30, 0x45, 0x19, 0x9b, 0x84, 0xb6,
+    0x0f, 0x0f, 0x5d, 0x91, 0x00, 0x88, 0x31, 0xf8, 0x6d, 0xe4, 0xa3, 0x78, 0xaa, 0xa2, 0xec, 0xf5,
+    0x0a, 0xa5, 0x0a, 0x0f, 0x4d, 0x5d, 0x5d, 0x0c, 0xc8, 0xfb, 0x92, 0xe3, 0x92, 0x4e, 0x16, 0x17,
+    0x25, 0x66, 0x94, 0x21, 0x9b, 0xb8, 0xc9, 0xba, 0x63, 0xff, 0xd7, 0x9d, 0xce, 0x26, 0x0d, 0xc6,
+    0xf9, 0xed, 0x9c, 0x7e, 0xdc, 0x09, 0x6d, 0x50, 0x62, 0xe6, 0x7b, 0x37, 0x83, 0xfb, 0x6b, 0xaa,
+    0x13, 0xbb, 0xa6, 0x18, 0x47, 0xee, 0x1d, 0xc1, 0xb8, 0x2c, 0xf0, 0xb2, 0x9a, 0xbb, 0x5d, 0xb8,
+    0x95, 0x6c, 0x94, 0x22, 0x98, 0x04, 0x81, 0x9c, 0xec, 0x4e, 0xd9, 0x12, 0x28, 0xeb, 0x62, 0xca,
+    0x64, 0xce, 0x52, 0x3a, 0x54, 0xc4, 0x89, 0x91, 0xa8, 0x35, 0x08, 0x39, 0xcb, 0x8d, 0x06, 0x8e,
+    0x33, 0x94, 0x5c, 0xc8, 0x18, 0xe8, 0x4b, 0xb1, 0xc8, 0x28, 0xc1, 0x68, 0x32, 0x52, 0xcb, 0xda,
+    0xe8, 0xdc, 0xa8, 0xab, 0x0d, 0xef, 0xba, 0xdc, 0xde, 0x6b, 0x3a, 0x31, 0x9e, 0xeb, 0xa3, 0xbc,
+    0xc6, 0xad, 0x51, 0x58, 0xb5, 0x56, 0xdf, 0x86, 0xb0, 0x4f, 0x88, 0xd0, 0xbb, 0x74, 0xd8, 0xf2,
+    0x3d, 0x3a, 0x6c, 0xb9, 0x53, 0xc7, 0xfa, 0xf2, 0x2e, 0xa9, 0x76, 0x48, 0xd5, 0x45, 0x80, 0x51,
+    0x71, 0x9c, 0xe2, 0x2b, 0x35, 0xed, 0x57, 0x85, 0x51, 0xfb, 0xe9, 0x2e, 0x8a, 0xd3, 0x41, 0xdb,
+    0xdd, 0x0d, 0x8b, 0x5b, 0x40, 0xee, 0xea, 0xa3, 0x6d, 0x5a, 0xc8, 0x85, 0xae, 0x14, 0x3e, 0x34,
+    0x04, 0x4b, 0x7c, 0xcb, 0x9c, 0xb7, 0xf0, 0x5b, 0x4c, 0x68, 0x52, 0x5e, 0x31, 0x6c, 0xbd, 0x16,
+    0x1f, 0xc5, 0xd6, 0xd8, 0xab, 0x6c, 0x77, 0x64, 0xd6, 0x2e, 0xed, 0x28, 0x61, 0x32, 0x46, 0x2a,
+    0xe8, 0xed, 0xf6, 0x05, 0x2e, 0xc8, 0x5d, 0xde, 0xba, 0x80, 0x5c, 0xfd, 0x3f, 0x64, 0x38, 0x16,
+    0x69, 0xda, 0xac, 0x78, 0x4e, 0xfd, 0xb1, 0x6b, 0xa8, 0xe7, 0xc3, 0x4c, 0x90, 0xa3, 0x19, 0x2c,
+    0x84, 0x49, 0x0a, 0xc0, 0x28, 0x53, 0x0b, 0x8d, 0x99, 0xa7, 0x21, 0x55, 0x11, 0x21, 0x2d, 0x68,
+    0x53, 0x17, 0x96, 0x56, 0xb0, 0x7a, 0xfb, 0xfa, 0xb1, 0xc3, 0xb8, 0x22, 0xb0, 0x86, 0x54, 0x2b,
+    0x2f, 0x2f, 0x7c, 0xdb, 0x03, 0x03, 0x9b, 0x13, 0xea, 0x56, 0x57, 0x01, 0xca, 0x9e, 0x57, 0x3e,
+    0x54, 0xc7, 0xd0, 0x98, 0xff, 0x55, 0x12, 0x07, 0xe3, 0x31, 0xbd, 0x68, 0xb4, 0xf3, 0x09, 0xce,
+    0x4e, 0xe8, 0x2f, 0x08, 0x8d, 0xea, 0x0f, 0x07, 0x43, 0x93, 0xd1, 0x57, 0xec, 0x07, 0xa1, 0x4e,
+    0x45, 0x84, 0xfe, 0xc9, 0x11, 0x9c, 0x9e, 0xbd, 0x30, 0xe7, 0x4e, 0xcc, 0x11, 0x8a, 0xc3, 0x34,
+    0xcc, 0x72, 0x9d, 0xd0, 0xcd, 0x8e, 0x56, 0xee, 0x93, 0x27, 0x03, 0x26, 0xc0, 0xb4, 0x9d, 0xac,
+    0xc0, 0x5d, 0x07, 0xf8, 0x5d, 0x36, 0x13, 0xdd, 0x94, 0x48, 0x47, 0x30, 0xc4, 0x6c, 0x8e, 0xd9,
+    0xf1, 0x90, 0x52, 0x87, 0xe2, 0xf2, 0x74, 0x50, 0x66, 0xbc, 0x10, 0x92, 0x53, 0x78, 0xc5, 0xe2,
+    0x90, 0xda, 0x7b, 0x84, 0x70, 0x70, 0xb0, 0xdb, 0x32, 0x2b, 0xe7, 0x05, 0x2f, 0xed, 0xd1, 0x8e,
+    0xe6, 0x0c, 0x68, 0x08, 0xf9, 0xde, 0x26, 0x02, 0xaf, 0xf4, 0xcc, 0x41, 0x43, 0x25, 0xa7, 0x54,
+    0x00, 0x2c, 0xb6, 0xa4, 0x4d, 0x13, 0x44, 0xcb, 0xac, 0x5b, 0xb0, 0xd3, 0x2e, 0xd3, 0xed, 0xc1,
+    0xcf, 0xe1, 0xe0, 0x57, 0x38, 0x63, 0x99, 0x46, 0x07, 0x0c, 0xc9, 0x7e, 0x16, 0x54, 0xbd, 0xb8,
+    0x78, 0x1b, 0x1c, 0x63, 0x42, 0x0e, 0x08, 0x59, 0x12, 0x6b, 0xb9, 0x4a, 0x10, 0x5d, 0x36, 0xfb,
+    0xca, 0xc2, 0x06, 0xfc, 0xec, 0xd1, 0x6b, 0x4e, 0x52, 0x9b, 0x13, 0x9c, 0x5b, 0x25, 0xbb, 0x29,
+    0x0b, 0x95, 0x64, 0x68, 0x70, 0x69, 0xca, 0x16, 0x4f, 0xf2, 0x2e, 0x80, 0x47, 0xd2, 0x78, 0xaa,
+    0x35, 0xd6, 0x9d, 0xe6, 0xb8, 0x76, 0xb7, 0xbb, 0xa6, 0x43, 0xfe, 0x03, 0xda, 0x96, 0xbf, 0xb7,
+    0xec, 0x08, 0x00, 0x00,
+};
+
+// style.css, 537 bytes gzipped
+static const uint8_t webAssetStyleCss[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xad, 0x54, 0x4d, 0x8f, 0x9b, 0x30,
+    0x10, 0xbd, 0xef, 0xaf, 0xb0, 0xb4, 0xaa, 0x72, 0x09, 0x11, 0x1f, 0x81, 0xb0, 0xa0, 0x1e, 0xfa,
+    0x3b, 0xaa, 0x3d, 0xd8, 0xd8, 0x0e, 0xd6, 0x82, 0x6d, 0xd9, 0xa6, 0x21, 0xad, 0xf6, 0xbf, 0xd7,
+    0x36, 0x4e, 0x03, 0x84, 0x48, 0x7b, 0xa8, 0xb8, 0xc0, 0xcc, 0x63, 0x66, 0xde, 0x7b, 0xf6, 0x20,
+    0x81, 0xaf, 0xe0, 0x0f, 0xa0, 0x82, 0x9b, 0x88, 0xc2, 0x9e, 0x75, 0xd7, 0x0a, 0xfc, 0x50, 0x0c,
+    0x76, 0x7b, 0xa0, 0x21, 0xd7, 0x91, 0x26, 0x8a, 0xd1, 0x1a, 0xf4, 0x50, 0x9d, 0x19, 0xaf, 0x40,
+    0x5c, 0x03, 0x09, 0x31, 0x66, 0xfc, 0x5c, 0x81, 0x34, 0x96, 0xa3, 0xcb, 0x8c, 0xd1, 0x85, 0x61,
+    0xd3, 0x56, 0xa0, 0x88, 0x43, 0x24, 0x60, 0x01, 0x1c, 0x8c, 0xa8, 0xc1, 0xe7, 0x4b, 0x9b, 0xec,
+    0x41, 0x9b, 0xda, 0x36, 0x8d, 0xe8, 0x84, 0xaa, 0xc0, 0x6b, 0x96, 0x65, 0x2e, 0x4e, 0x85, 0xea,
+    0x6d, 0x14, 0xc1, 0xe6, 0xe3, 0xac, 0xc4, 0xc0, 0xb1, 0x4d, 0xd1, 0xdc, 0x3d, 0x0f, 0x6d, 0x90,
+    0x50, 0x98, 0xa8, 0x48, 0x41, 0xcc, 0x06, 0x5d, 0x81, 0x72, 0xde, 0x28, 0xc9, 0xe5, 0xe8, 0x26,
+    0xfb, 0x7c, 0x39, 0xb8, 0x8a, 0x91, 0xab, 0x25, 0x6d, 0xdd, 0x29, 0x1f, 0x21, 0x61, 0x8c, 0xe8,
+    0x27, 0x98, 0x03, 0x75, 0x10, 0x91, 0xce, 0xa6, 0x31, 0xd3, 0xb2, 0x83, 0x96, 0x2f, 0xea, 0x44,
+    0xf3, 0x51, 0xaf, 0xe1, 0x01, 0xcd, 0xb8, 0x1c, 0xcc, 0x4f, 0x73, 0x95, 0xe4, 0xfb, 0xce, 0x90,
+    0xd1, 0xec, 0xde, 0xf7, 0x60, 0x1e, 0xe3, 0x43, 0x8f, 0x88, 0x5a, 0x47, 0x25, 0xd4, 0xfa, 0x62,
+    0x47, 0xde, 0xbd, 0xdb, 0x46, 0x41, 0x9e, 0x24, 0x8e, 0xbf, 0xcd, 0x78, 0x79, 0x0a, 0x5e, 0x77,
+    0xcd, 0x7e, 0x13, 0x9b, 0x2e, 0xee, 0x3c, 0xed, 0x97, 0xa5, 0xa4, 0x45, 0xc7, 0x30, 0x78, 0xc5,
+    0x18, 0x3f, 0xf0, 0x3f, 0x4e, 0xd8, 0xd1, 0xfd, 0xeb, 0xab, 0x85, 0xbc, 0x0d, 0xad, 0x87, 0xd6,
+    0x03, 0xea, 0xd9, 0xc3, 0xd8, 0x68, 0xb0, 0x2c, 0xb9, 0x1f, 0x6f, 0x21, 0x7f, 0x1c, 0x9f, 0x10,
+    0xb5, 0x86, 0x07, 0xa7, 0x2e, 0x2d, 0x33, 0xe4, 0x3e, 0x15, 0x17, 0x9c, 0xcc, 0x28, 0x24, 0xd6,
+    0x9a, 0xe0, 0xcf, 0x13, 0x22, 0xcb, 0x81, 0x9b, 0x41, 0x69, 0x57, 0x55, 0x0a, 0xc6, 0x0d, 0x51,
+    0xf5, 0x52, 0x99, 0xb5, 0x5d, 0xb1, 0x7c, 0xca, 0xa5, 0x6a, 0xc5, 0x2f, 0xa2, 0xb6, 0x19, 0x4d,
+    0xb9, 0x47, 0x5e, 0x79, 0x81, 0xb2, 0x75, 0xbd, 0x67, 0x2a, 0x24, 0x27, 0x98, 0xa2, 0xf2, 0x19,
+    0x7a, 0xbb, 0x43, 0x92, 0x95, 0xc7, 0xb7, 0xc2, 0x9f, 0x42, 0x6d, 0xa0, 0x19, 0xf4, 0x1a, 0x40,
+    0x4a, 0x7a, 0xa4, 0x78, 0x25, 0xdf, 0xb6, 0x50, 0x2b, 0x29, 0xd2, 0x20, 0xc5, 0x41, 0x5f, 0xb5,
+    0x21, 0x7d, 0x84, 0x0c, 0xdf, 0x83, 0x43, 0x2b, 0x7a, 0xe2, 0x5e, 0x37, 0x8e, 0xf2, 0xa2, 0x6f,
+    0x5a, 0xc2, 0xd3, 0x31, 0xff, 0xaa, 0xa5, 0xe9, 0xff, 0xb7, 0x74, 0x22, 0xe0, 0x6e, 0xa8, 0xbb,
+    0x40, 0x11, 0xec, 0xd8, 0xd9, 0xc6, 0x1a, 0x32, 0xfd, 0xe0, 0x63, 0x98, 0x34, 0x42, 0x41, 0xc3,
+    0x04, 0xbf, 0x4d, 0xb4, 0x60, 0x7b, 0xf3, 0xfb, 0x1f, 0xe7, 0x6d, 0x0b, 0xd2, 0xa4, 0x2c, 0x33,
+    0x6f, 0xdb, 0x41, 0x11, 0x4d, 0x4c, 0x50, 0x67, 0x81, 0xc1, 0x4d, 0x96, 0x3b, 0x35, 0xe6, 0x98,
+    0xed, 0x6a, 0x4d, 0x99, 0x86, 0x3d, 0x65, 0xd7, 0x8a, 0x30, 0x1e, 0x10, 0x8c, 0x31, 0x42, 0x56,
+    0x20, 0xf3, 0x2a, 0xad, 0xf7, 0xd4, 0x62, 0x97, 0x95, 0xf4, 0x8d, 0xc2, 0x6d, 0xe1, 0xb6, 0xa4,
+    0xb8, 0x77, 0xba, 0xaf, 0x2f, 0xbf, 0x88, 0x9c, 0x76, 0xb7, 0xdd, 0x59, 0x14, 0xfe, 0x90, 0xfd,
+    0x05, 0x7e, 0xd3, 0x35, 0x51, 0xb9, 0x05, 0x00, 0x00,
+};
+
+static const WebAsset webAssets[] = {
+    {"/config.js", "application/javascript", "\"e5a4ca66d51e1a742394a2e4caf6e706\"", webAssetConfigJs, 820},
+    {"/style.css", "text/css", "\"8c65a669dcb2ba9620b38cae571e98e8\"", webAssetStyleCss, 537},
+};
@@ -1,5 +1,7 @@
 // Move WiFi-related functions to a new file
 
+#pragma once
+
 #include "WiFiManager.h"
 #include "ESP8266WebServer.h"
 #include <PubSubClient.h>
@@ -71,9 +73,19 @@ struct SystemCommandConfig {
 
 struct FirmwareConfig {
     char update_url[512];  // URL for firmware updates
+    bool auto_update;      // Install what the background check finds, off = only report it
     
     FirmwareConfig() {
         update_url[0] = '\0';  // Initialize empty
+        auto_update = false;
+    }
+};
+
+struct NotifyConfig {
+    char url[128];  // Endpoint for connect notifications (plain HTTP), empty = http://ntfy.sh/<mac>
+    
+    NotifyConfig() {
+        url[0] = '\0';
     }
 };
 
@@ -83,13 +95,24 @@ extern DisplayConfig displayConfig;
 extern DeviceConfig deviceConfig;
 extern SystemCommandConfig systemCommandConfig;  // Add the extern declaration
 extern FirmwareConfig firmwareConfig;  // Add firmware config
-
-// Declare the server object as extern to avoid multiple definitions
-extern ESP8266WebServer server;
+extern NotifyConfig notifyConfig;
+
+// Declare the server object as extern to avoid multiple definitions.
+// Build with -D ASYNC_HTTP_SERVER for the event-driven server, the routes are the same.
+#ifdef ASYNC_HTTP_SERVER
+#include "AsyncHttpServer.h"
+typedef AsyncHttpServer WebServer;
+#else
+typedef ESP8266WebServer WebServer;
+#endif
+extern WebServer server;
 
 // Declare displaySetupMessage as an external function
 extern void displaySetupMessage(const char* message);
 
+// Intensity the displays are currently set to (main.cpp)
+extern uint8_t getDisplayIntensity();
+
 // Declare mqttClient as an external object
 extern PubSubClient mqttClient;
 
@@ -105,6 +128,7 @@ void handleSave();
 
 // Declare MQTT setup and reconnect functions
 void setupMQTT();
+void restartMQTT();     // Drop the connection and set up again with the current settings
 void reconnectMQTT();
 
 // Declare the publishMQTTData function
@@ -113,6 +137,7 @@ void publishMQTTData(float temperature, float humidity);
 // Function declarations for Telnet
 void setupTelnet();
 void handleTelnet();
+void handleTelnetCommand(const char* command);
 void printBoth(const char* message);
 void printBoth(const String& message);
 void printBothf(const char* format, ...);
@@ -151,3 +176,61 @@ void loadFirmwareConfig();
 void saveFirmwareConfig();
 void setDefaultFirmwareConfig();
 void displayUpdateProgress(int progress, const char* status);
+
+// Notification endpoint configuration
+void loadNotifyConfig();
+void saveNotifyConfig();
+void setDefaultNotifyConfig();
+
+// Config sections that can be marked dirty and committed to flash later
+enum ConfigSection : uint8_t {
+    CONFIG_MQTT           = 1 << 0,
+    CONFIG_TIME           = 1 << 1,
+    CONFIG_DISPLAY        = 1 << 2,
+    CONFIG_DEVICE         = 1 << 3,
+    CONFIG_SYSTEM_COMMAND = 1 << 4,
+    CONFIG_FIRMWARE       = 1 << 5,
+    CONFIG_NOTIFY         = 1 << 6
+};
+
+#define CONFIG_SAVE_DEBOUNCE_MS 3000  // Quiet time before dirty config is written to flash
+
+// Debounced config commits - call flushPendingConfig() from loop()
+void markConfigDirty(uint8_t sections);
+void flushPendingConfig(bool force = false);
+
+// Deferred job once a new image is in: commits pending config, then restarts into it
+void restartAfterUpdate();
+
+// Only touch a field when the new value differs, so callers know what really changed
+template <typename T, typename V>
+bool updateField(T& field, V value) {
+    T newValue = (T)value;
+    if (field == newValue) {
+        return false;
+    }
+    field = newValue;
+    return true;
+}
+
+inline bool updateField(char* field, size_t size, const char* value) {
+    if (strncmp(field, value, size - 1) == 0) {
+        return false;
+    }
+    strlcpy(field, value, size);
+    return true;
+}
+
+// Splits http://host[:port]/path, path points into url. https:// only when allowHttps.
+bool parseHttpUrl(const char* url, char* host, size_t hostSize, uint16_t& port, const char*& path,
+                  bool allowHttps = false);
+
+// Sends doc as the whole response body, streamed to the client without an intermediate String
+void sendJsonResponse(int code, const JsonDocument& doc);
+
+extern uint32_t configWritesCommitted;  // Config files actually rewritten on flash
+extern uint32_t configWritesAvoided;    // Writes skipped (unchanged bytes or coalesced saves)
+
+extern uint32_t mqttPublishes;          // Messages the broker accepted
+extern uint32_t mqttReconnects;         // Successful broker connections
+extern uint32_t mqttFailures;           // Failed connection attempts and publishes
@@ -0,0 +1,182 @@
+import argparse
+import http.client
+import json
+import sys
+import threading
+import time
+from urllib.parse import urlparse
+
+# Load generator for the clock's web server. Drives the firmware's routes from
+# several threads at once and reports requests per second, latency percentiles
+# and the device's heap low-water mark (from /api/heap), so web server changes
+# can be compared by numbers. Works against a device on the LAN or anything
+# serving the same routes on loopback:
+#
+#   python load_test.py http://bedroomclock.local
+#   python load_test.py http://127.0.0.1:8080 --concurrency 8 --duration 30
+
+FORM = "application/x-www-form-urlencoded"
+
+# name, method, path, body, content type, expected status. The POSTs carry no
+# fields, so they exercise the handlers without changing any settings.
+ROUTES = [
+    ("root", "GET", "/", None, None, 200),
+    ("save", "POST", "/save", "", FORM, 200),
+    ("system", "GET", "/system", None, None, 200),
+    ("settime", "POST", "/settime", "", FORM, 400),
+    ("config", "GET", "/api/config", None, None, 200),
+    ("boot", "GET", "/api/boot", None, None, 200),
+    ("ntp", "GET", "/api/ntp", None, None, 200),
+    ("heap", "GET", "/api/heap", None, None, 200),
+]
+
+
+class Result:
+    def __init__(self):
+        self.latencies = []
+        self.unexpected = 0     # Answered, but not with the expected status
+        self.busy = 0           # 503 from a full connection pool
+        self.errors = 0         # Connection refused, reset or timed out
+        self.bytes = 0
+
+
+def request(host, port, method, path, body, content_type, timeout):
+    connection = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        headers = {"Connection": "close"}
+        if content_type:
+            headers["Content-Type"] = content_type
+        connection.request(method, path, body=body, headers=headers)
+        response = connection.getresponse()
+        data = response.read()
+        return response.status, data
+    finally:
+        connection.close()
+
+
+def fetch_heap(host, port, timeout, reset=False):
+    try:
+        status, data = request(host, port, "GET", "/api/heap?reset=1" if reset else "/api/heap",
+                               None, None, timeout)
+        if status == 200:
+            return json.loads(data)
+    except (OSError, http.client.HTTPException, ValueError):
+        pass
+    return None
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(round(fraction * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+def worker(host, port, routes, results, lock, deadline, remaining, timeout, offset):
+    index = offset
+    while time.monotonic() < deadline:
+        with lock:
+            if remaining[0] is not None:
+                if remaining[0] <= 0:
+                    return
+                remaining[0] -= 1
+
+        name, method, path, body, content_type, expected = routes[index % len(routes)]
+        index += 1
+
+        start = time.perf_counter()
+        try:
+            status, data = request(host, port, method, path, body, content_type, timeout)
+        except (OSError, http.client.HTTPException):
+            with lock:
+                results[name].errors += 1
+            continue
+        elapsed = time.perf_counter() - start
+
+        with lock:
+            result = results[name]
+            result.bytes += len(data)
+            if status == expected:
+                result.latencies.append(elapsed)
+            elif status == 503:
+                result.busy += 1
+            else:
+                result.unexpected += 1
+
+
+def print_row(name, result, elapsed):
+    latencies = sorted(result.latencies)
+    ms = [percentile(latencies, p) * 1000 for p in (0.5, 0.9, 0.99, 1.0)]
+    print(f"{name:<10}{len(latencies):>8}{len(latencies) / elapsed:>9.1f}"
+          f"{ms[0]:>9.1f}{ms[1]:>9.1f}{ms[2]:>9.1f}{ms[3]:>9.1f}"
+          f"{result.busy:>7}{result.unexpected:>7}{result.errors:>7}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load test the clock's web server")
+    parser.add_argument("url", help="Base URL, e.g. http://bedroomclock.local or http://127.0.0.1:8080")
+    parser.add_argument("--concurrency", type=int, default=4, help="Parallel clients (default 4)")
+    parser.add_argument("--duration", type=float, default=20, help="Seconds to run (default 20)")
+    parser.add_argument("--requests", type=int, help="Stop after this many requests instead")
+    parser.add_argument("--routes", help="Comma separated subset of: " + ", ".join(r[0] for r in ROUTES))
+    parser.add_argument("--timeout", type=float, default=10, help="Per-request timeout in seconds")
+    args = parser.parse_args()
+
+    url = urlparse(args.url)
+    host = url.hostname
+    port = url.port or 80
+
+    routes = ROUTES
+    if args.routes:
+        wanted = args.routes.split(",")
+        routes = [r for r in ROUTES if r[0] in wanted]
+        if not routes:
+            parser.error("no known routes selected")
+
+    heap_before = fetch_heap(host, port, args.timeout, reset=True)
+
+    results = {r[0]: Result() for r in routes}
+    lock = threading.Lock()
+    remaining = [args.requests]
+    deadline = time.monotonic() + (args.duration if args.requests is None else 3600)
+
+    print(f"Driving {len(routes)} routes on {host}:{port} with {args.concurrency} clients...")
+    start = time.monotonic()
+    threads = [threading.Thread(target=worker,
+                                args=(host, port, routes, results, lock, deadline, remaining, args.timeout, i))
+               for i in range(args.concurrency)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - start
+
+    heap_after = fetch_heap(host, port, args.timeout)
+
+    print()
+    print(f"{'route':<10}{'ok':>8}{'req/s':>9}{'p50 ms':>9}{'p90 ms':>9}{'p99 ms':>9}{'max ms':>9}"
+          f"{'503':>7}{'other':>7}{'error':>7}")
+    total = Result()
+    for name, result in results.items():
+        print_row(name, result, elapsed)
+        total.latencies += result.latencies
+        total.busy += result.busy
+        total.unexpected += result.unexpected
+        total.errors += result.errors
+        total.bytes += result.bytes
+    print_row("all", total, elapsed)
+
+    print()
+    print(f"{elapsed:.1f} s, {total.bytes / 1024 / elapsed:.1f} KB/s received")
+    if heap_before and heap_after:
+        print(f"Heap: {heap_before['free']} bytes free before, {heap_after['free']} after, "
+              f"low-water mark {heap_after['low_water']}, "
+              f"largest block {heap_after['max_block']}, fragmentation {heap_after['fragmentation']}%")
+    else:
+        print("Heap: /api/heap not available")
+
+    return 1 if total.errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,24 +1,238 @@
+import gzip
+import hashlib
+import json
 import os
+import re
 import shutil
+import struct
 import subprocess
 import time
 
+# The ESP8266 bootloader inflates gzipped images while it copies them into place,
+# so firmware.bin.gz can go through /update, ArduinoOTA or the pull OTA as-is and
+# far fewer bytes cross the network.
+def compress_firmware(firmware_path, compressed_path):
+    with open(firmware_path, "rb") as f:
+        data = f.read()
+    # mtime=0 keeps the output byte-identical for identical firmware
+    compressed = gzip.compress(data, compresslevel=9, mtime=0)
+    with open(compressed_path, "wb") as f:
+        f.write(compressed)
+    print(f"Compressed firmware to {compressed_path} ({len(compressed)} of {len(data)} bytes, "
+          f"{100 * len(compressed) / len(data):.0f}%).")
+    return len(compressed)
+
+# Signed images end with an RSA signature over the SHA-256 of everything before it,
+# then the signature's length (u32, little endian). That is the layout Update checks
+# when the firmware has a key built in by update_signing.py. Like the core's
+# signing.py this leaves the cryptography to openssl.
+SIGNING_KEY = "private.key"     # Next to platformio.ini, never committed
+
+def sign_image(path, key_path):
+    with open(path, "rb") as f:
+        data = f.read()
+    signature = subprocess.run(["openssl", "dgst", "-sha256", "-sign", key_path],
+                               input=data, capture_output=True, check=True).stdout
+    with open(path, "ab") as f:
+        f.write(signature + struct.pack("<I", len(signature)))
+
+# Update leaves the signature out of the image it installs, so a signed build's
+# delta has to start from the image without one.
+def strip_signature(data):
+    if len(data) < 4:
+        return data
+    length = struct.unpack("<I", data[-4:])[0]
+    if length not in (256, 384, 512) or length + 4 >= len(data):
+        return data
+    return data[:-(length + 4)]
+
+# Delta images (firmware.delta) rebuild the new firmware on the clock from the one
+# it is running plus the bytes that changed. Format, little endian, matching
+# DeltaPatch.cpp:
+#   "DCP1", old size (u32), old SHA-256, new size (u32), new SHA-256
+#   then operations until new size bytes are produced:
+#   0x01 COPY    varint zigzag(old offset - end of the previous copy), varint length
+#   0x02 INSERT  varint length, then that many bytes
+DELTA_MAGIC = b"DCP1"
+DELTA_COPY = 1
+DELTA_INSERT = 2
+DELTA_WINDOW = 16       # Bytes hashed to find matches in the old image
+DELTA_MIN_MATCH = 24    # Shorter matches at a new offset cost more than inserting
+DELTA_MIN_RESUME = 8    # Continuing right after the previous copy is almost free
+DELTA_CANDIDATES = 8    # Old offsets remembered per window
+
+def _varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+def _match_length(old, old_pos, new, new_pos):
+    length = 0
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    # Whole blocks first, byte by byte only for the tail
+    while length + 64 <= limit and old[old_pos + length:old_pos + length + 64] == new[new_pos + length:new_pos + length + 64]:
+        length += 64
+    while length < limit and old[old_pos + length] == new[new_pos + length]:
+        length += 1
+    return length
+
+def make_delta(old, new):
+    index = {}
+    for pos in range(len(old) - DELTA_WINDOW + 1):
+        offsets = index.setdefault(old[pos:pos + DELTA_WINDOW], [])
+        if len(offsets) < DELTA_CANDIDATES:
+            offsets.append(pos)
+
+    ops = bytearray()
+    literal = bytearray()
+    copy_end = 0
+
+    def flush_literal():
+        if literal:
+            ops.extend(bytes([DELTA_INSERT]) + _varint(len(literal)) + literal)
+            literal.clear()
+
+    pos = 0
+    while pos < len(new):
+        # Code that moved keeps its neighbours, so try right after the last copy first
+        best_offset = copy_end
+        best_length = _match_length(old, copy_end, new, pos) if copy_end < len(old) else 0
+        if best_length < DELTA_MIN_RESUME:
+            best_length = 0
+            for offset in index.get(new[pos:pos + DELTA_WINDOW], ()):
+                length = _match_length(old, offset, new, pos)
+                if length > best_length:
+                    best_offset, best_length = offset, length
+            if best_length < DELTA_MIN_MATCH:
+                best_length = 0
+
+        if best_length == 0:
+            literal.append(new[pos])
+            pos += 1
+            continue
+
+        flush_literal()
+        delta = best_offset - copy_end
+        ops.extend(bytes([DELTA_COPY]) + _varint(delta * 2 if delta >= 0 else -delta * 2 - 1) + _varint(best_length))
+        copy_end = best_offset + best_length
+        pos += best_length
+    flush_literal()
+
+    header = (DELTA_MAGIC + struct.pack("<I", len(old)) + hashlib.sha256(old).digest() +
+              struct.pack("<I", len(new)) + hashlib.sha256(new).digest())
+    return header + bytes(ops)
+
+def apply_delta(old, delta):
+    def varint(pos):
+        value = shift = 0
+        while True:
+            byte = delta[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value, pos
+
+    if delta[:4] != DELTA_MAGIC or hashlib.sha256(old).digest() != delta[8:40]:
+        raise ValueError("delta does not apply to this image")
+    new_size = struct.unpack("<I", delta[40:44])[0]
+    out = bytearray()
+    copy_end = 0
+    pos = 76
+    while len(out) < new_size:
+        op = delta[pos]
+        pos += 1
+        if op == DELTA_COPY:
+            zigzag, pos = varint(pos)
+            length, pos = varint(pos)
+            offset = copy_end + (zigzag >> 1 if not zigzag & 1 else -((zigzag + 1) >> 1))
+            out += old[offset:offset + length]
+            copy_end = offset + length
+        elif op == DELTA_INSERT:
+            length, pos = varint(pos)
+            out += delta[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"bad delta operation {op}")
+    if hashlib.sha256(out).digest() != delta[44:76]:
+        raise ValueError("delta produced the wrong image")
+    return bytes(out)
+
+# A delta is only worth publishing when it beats the gzipped full image
+def publish_delta(previous, firmware_path, delta_path, compressed_size):
+    with open(firmware_path, "rb") as f:
+        new = f.read()
+    if previous is None or previous == new:
+        if os.path.exists(delta_path):
+            os.remove(delta_path)
+        return
+
+    delta = make_delta(previous, new)
+    # Never publish a delta the clock could not turn back into this build
+    apply_delta(previous, delta)
+    if len(delta) >= compressed_size:
+        print(f"Delta ({len(delta)} bytes) is no smaller than the compressed image, not published.")
+        if os.path.exists(delta_path):
+            os.remove(delta_path)
+        return
+
+    with open(delta_path, "wb") as f:
+        f.write(delta)
+    print(f"Wrote delta from the previous firmware to {delta_path} ({len(delta)} bytes).")
+
+# manifest.json is what the clock polls: the version decides whether to download at
+# all and the SHA-256 of the file it fetches is checked before the image is committed.
+# Top-level size and sha256 are firmware.bin, the image a delta has to produce.
+def firmware_version(project_dir):
+    with open(os.path.join(project_dir, "src", "WiFiSetup.cpp")) as f:
+        match = re.search(r"float version = ([0-9.]+)f?;", f.read())
+    if not match:
+        raise ValueError("version not found in src/WiFiSetup.cpp")
+    return float(match.group(1))
+
+def write_manifest(manifest_path, version, paths):
+    def describe(path):
+        with open(path, "rb") as f:
+            data = f.read()
+        return {"size": len(data), "sha256": hashlib.sha256(data).hexdigest()}
+
+    files = {os.path.basename(path): describe(path) for path in paths if os.path.exists(path)}
+    manifest = {"version": version, **files["firmware.bin"], "files": files}
+    with open(manifest_path, "w") as f:
+        json.dump(manifest, f, indent=2)
+        f.write("\n")
+    print(f"Wrote {manifest_path} for version {version}.")
+
 def after_build(source, target, env):
     print("Executing after_build script...")
     firmware_path = os.path.join(env.subst(".pio/build/${PIOENV}"), "firmware.bin")
     destination_path = os.path.join(env.subst("$PROJECT_DIR"), "fwroot", "firmware.bin")
+    compressed_path = destination_path + ".gz"
+    delta_path = os.path.join(os.path.dirname(destination_path), "firmware.delta")
+    manifest_path = os.path.join(os.path.dirname(destination_path), "manifest.json")
 
     print(f"Firmware path: {firmware_path}")
     print(f"Destination path: {destination_path}")
 
-    # Delete the old firmware file if it exists
+    # Delete the old firmware files if they exist, keeping the image as the delta base
+    previous = None
     if os.path.exists(destination_path):
+        with open(destination_path, "rb") as f:
+            previous = f.read()
         os.remove(destination_path)
         print(f"Deleted old firmware from {destination_path}.")
+        if os.path.exists(compressed_path):
+            os.remove(compressed_path)
 
         # Check in the delete to Git
         try:
-            subprocess.run(["git", "add", destination_path], check=True)
+            subprocess.run(["git", "add", "-A", os.path.dirname(destination_path)], check=True)
             subprocess.run(["git", "commit", "-m", "deleted old fw"], check=True)
             print("Checked in deletion of old firmware with comment 'deleted old fw'.")
         except subprocess.CalledProcessError as e:
@@ -26,12 +240,28 @@ def after_build(source, target, env):
 
     # Copy the new firmware file
     if os.path.exists(firmware_path):
+        compressed_size = compress_firmware(firmware_path, compressed_path)
+        key_path = os.path.join(env.subst("$PROJECT_DIR"), SIGNING_KEY)
+        if os.path.exists(key_path):
+            if previous is not None:
+                previous = strip_signature(previous)
+            # Update checks the bytes it writes, so the .gz has a signature of its own.
+            # The build output is signed in place for ArduinoOTA uploads.
+            sign_image(compressed_path, key_path)
+            sign_image(firmware_path, key_path)
+            compressed_size = os.path.getsize(compressed_path)
+            print(f"Signed the firmware images with {key_path}.")
+        else:
+            print(f"No {SIGNING_KEY}, the firmware images are not signed.")
         shutil.copy(firmware_path, destination_path)
         print(f"Copied new firmware to {destination_path}.")
+        publish_delta(previous, destination_path, delta_path, compressed_size)
+        write_manifest(manifest_path, firmware_version(env.subst("$PROJECT_DIR")),
+                       [destination_path, compressed_path, delta_path])
 
         # Check in the new firmware to Git
         try:
-            subprocess.run(["git", "add", destination_path], check=True)
+            subprocess.run(["git", "add", "-A", os.path.dirname(destination_path)], check=True)
             timestamp = time.strftime("%Y-%m-%d %H:%M:%S")
             subprocess.run(["git", "commit", "-m", f"New fw upload - {timestamp}"], check=True)
             print("Checked in new firmware with comment 'New fw upload'.")
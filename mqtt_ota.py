@@ -0,0 +1,209 @@
+import argparse
+import hashlib
+import json
+import select
+import socket
+import struct
+import sys
+import time
+
+# Sends firmware to a clock over MQTT, for clocks whose web server can't be
+# reached but that keep their broker session. Talks to the broker the clock
+# uses (a local mosquitto works for trying it out) and follows the protocol in
+# include/MqttOta.h: begin, then numbered chunks, never more than a window
+# ahead of the clock's last ack.
+#
+#   python mqtt_ota.py --broker 192.168.1.10 bedroomclock fwroot/firmware.bin.gz
+#   python mqtt_ota.py --broker localhost --user clock --password secret bedroomclock firmware.bin
+
+ACK_TIMEOUT = 5         # Seconds without an ack before the window is sent again
+BEGIN_TIMEOUT = 10
+RETRIES = 8
+
+
+class MqttClient:
+    """Just enough MQTT 3.1.1 for this script: QoS 0 publish and subscribe."""
+
+    def __init__(self, host, port, client_id, user=None, password=None, keepalive=30):
+        self.sock = socket.create_connection((host, port), timeout=10)
+        self.keepalive = keepalive
+        self.last_sent = time.monotonic()
+        self.pending = b""
+
+        flags = 0x02    # Clean session
+        payload = self._string(client_id.encode())
+        if user:
+            flags |= 0x80
+            payload += self._string(user.encode())
+            if password:
+                flags |= 0x40
+                payload += self._string(password.encode())
+        header = self._string(b"MQTT") + bytes([4, flags]) + struct.pack(">H", keepalive)
+        self._send(0x10, header + payload)
+        packet_type, body = self._read_packet(10)
+        if packet_type != 0x20 or body[1] != 0:
+            raise ConnectionError(f"broker refused the connection ({body[1] if body else '?'})")
+
+    @staticmethod
+    def _string(data):
+        return struct.pack(">H", len(data)) + data
+
+    def _send(self, first_byte, body):
+        length = len(body)
+        encoded = bytearray()
+        while True:
+            byte = length % 128
+            length //= 128
+            encoded.append(byte | 0x80 if length else byte)
+            if not length:
+                break
+        self.sock.sendall(bytes([first_byte]) + bytes(encoded) + body)
+        self.last_sent = time.monotonic()
+
+    def _read_packet(self, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            # Fixed header, remaining length, body
+            if len(self.pending) >= 2:
+                length = shift = 0
+                pos = 1
+                while pos < len(self.pending):
+                    byte = self.pending[pos]
+                    length |= (byte & 0x7F) << shift
+                    shift += 7
+                    pos += 1
+                    if not byte & 0x80:
+                        if len(self.pending) >= pos + length:
+                            packet_type = self.pending[0] & 0xF0
+                            body = self.pending[pos:pos + length]
+                            self.pending = self.pending[pos + length:]
+                            return packet_type, body
+                        break
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None, None
+            readable, _, _ = select.select([self.sock], [], [], remaining)
+            if readable:
+                data = self.sock.recv(4096)
+                if not data:
+                    raise ConnectionError("broker closed the connection")
+                self.pending += data
+
+    def subscribe(self, topic):
+        self._send(0x82, struct.pack(">H", 1) + self._string(topic.encode()) + b"\x00")
+
+    def publish(self, topic, payload):
+        self._send(0x30, self._string(topic.encode()) + payload)
+
+    def receive(self, timeout):
+        """Next (topic, payload) published to us, None when timeout passes first."""
+        deadline = time.monotonic() + timeout
+        while True:
+            if time.monotonic() - self.last_sent > self.keepalive / 2:
+                self._send(0xC0, b"")    # PINGREQ
+            packet_type, body = self._read_packet(max(0, min(deadline - time.monotonic(), self.keepalive / 2)))
+            if packet_type == 0x30:
+                topic_length = struct.unpack(">H", body[:2])[0]
+                return body[2:2 + topic_length].decode(), body[2 + topic_length:]
+            if packet_type is None and time.monotonic() >= deadline:
+                return None
+
+    def close(self):
+        try:
+            self._send(0xE0, b"")        # DISCONNECT
+        finally:
+            self.sock.close()
+
+
+def wait_ack(client, topic, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        message = client.receive(deadline - time.monotonic())
+        if message and message[0] == topic:
+            return json.loads(message[1])
+    return None
+
+
+def send_firmware(client, hostname, image):
+    base = f"homeassistant/{hostname}/ota/"
+    client.subscribe(base + "ack")
+    begin = json.dumps({"size": len(image), "sha256": hashlib.sha256(image).hexdigest()}).encode()
+
+    for attempt in range(RETRIES):
+        client.publish(base + "begin", begin)
+        ack = wait_ack(client, base + "ack", BEGIN_TIMEOUT)
+        if ack and ack["state"] == "ready":
+            break
+        if ack and ack["state"] == "failed":
+            print(f"Clock refused the update: {ack.get('error')}")
+            return False
+    else:
+        print("No answer from the clock, is it connected to this broker?")
+        return False
+
+    window, chunk_size = ack["window"], ack["chunk"]
+    chunks = (len(image) + chunk_size - 1) // chunk_size
+    acked = sent = 0
+    rewound_to = None
+    timeouts = 0
+    start = time.monotonic()
+    while True:
+        while sent < min(acked + window, chunks):
+            data = image[sent * chunk_size:(sent + 1) * chunk_size]
+            client.publish(base + "chunk", struct.pack("<I", sent) + data)
+            sent += 1
+
+        ack = wait_ack(client, base + "ack", ACK_TIMEOUT)
+        if ack is None:
+            timeouts += 1
+            if timeouts > RETRIES:
+                print("\nThe clock stopped answering")
+                return False
+            sent = acked     # Send the window again
+            continue
+        timeouts = 0
+
+        if ack["state"] == "done":
+            elapsed = time.monotonic() - start
+            print(f"\r{len(image)} of {len(image)} bytes, {len(image) / 1024 / elapsed:.1f} KB/s")
+            print("Update complete, the clock is restarting")
+            return True
+        if ack["state"] != "receiving" and ack["state"] != "ready":
+            print(f"\nUpdate failed: {ack.get('error', ack['state'])}")
+            return False
+
+        next_seq = ack["next"]
+        acked = max(acked, next_seq)
+        # Behind what was sent: chunks got lost, go back once per gap
+        if next_seq < sent and next_seq != rewound_to:
+            sent = next_seq
+            rewound_to = next_seq
+        elapsed = time.monotonic() - start
+        done = min(acked * chunk_size, len(image))
+        print(f"\r{done} of {len(image)} bytes, {done / 1024 / elapsed if elapsed else 0:.1f} KB/s ",
+              end="", flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Firmware update for a clock over MQTT")
+    parser.add_argument("hostname", help="the clock's hostname, as in its MQTT topics")
+    parser.add_argument("firmware", help="firmware.bin or firmware.bin.gz")
+    parser.add_argument("--broker", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user")
+    parser.add_argument("--password")
+    args = parser.parse_args()
+
+    with open(args.firmware, "rb") as f:
+        image = f.read()
+    client = MqttClient(args.broker, args.port, f"mqtt_ota-{args.hostname}-{int(time.time())}",
+                        args.user, args.password)
+    try:
+        ok = send_firmware(client, args.hostname, image)
+    finally:
+        client.close()
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
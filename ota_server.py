@@ -0,0 +1,92 @@
+import argparse
+import hashlib
+import http.server
+import os
+import time
+
+# Local stand-in for the firmware server. Serves fwroot/ over plain HTTP so the
+# clock's pull OTA (/performUpdate) can be tried on the LAN, optionally slowed
+# down or cut short to exercise the progress display, timeouts and failures:
+#
+#   python ota_server.py --port 8000
+#   python ota_server.py --rate 20 --fail-after 100000
+#
+# then set the update URL to http://<this machine>:8000/firmware.bin
+#
+# Every file gets an ETag so the clock's manifest.json polls can be answered with
+# 304 Not Modified, like GitHub Pages does.
+
+CHUNK_SIZE = 1024
+
+
+def make_handler(args):
+    class FirmwareHandler(http.server.SimpleHTTPRequestHandler):
+        def __init__(self, *handler_args, **kwargs):
+            super().__init__(*handler_args, directory=args.root, **kwargs)
+
+        def do_GET(self):
+            path = self.translate_path(self.path)
+            if not os.path.isfile(path):
+                self.send_error(404)
+                return
+
+            with open(path, "rb") as f:
+                data = f.read()
+
+            etag = '"%s"' % hashlib.sha256(data).hexdigest()[:16]
+            if self.headers.get("If-None-Match") == etag:
+                self.send_response(304)
+                self.send_header("ETag", etag)
+                self.send_header("Connection", "close")
+                self.end_headers()
+                self.close_connection = True
+                return
+
+            self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("ETag", etag)
+            if not args.no_length:
+                self.send_header("Content-Length", str(len(data)))
+            self.send_header("Connection", "close")
+            self.end_headers()
+
+            limit = args.fail_after if args.fail_after is not None else len(data)
+            start = time.monotonic()
+            sent = 0
+            while sent < min(limit, len(data)):
+                chunk = data[sent:min(sent + CHUNK_SIZE, limit)]
+                self.wfile.write(chunk)
+                sent += len(chunk)
+                if args.rate:
+                    # Sleep until the average is back down to the requested rate
+                    ahead = sent / (args.rate * 1024) - (time.monotonic() - start)
+                    if ahead > 0:
+                        time.sleep(ahead)
+
+            elapsed = time.monotonic() - start
+            self.log_message("sent %d of %d bytes in %.1f s (%.1f KB/s)",
+                             sent, len(data), elapsed, sent / 1024 / elapsed if elapsed else 0)
+            self.close_connection = True
+
+    return FirmwareHandler
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve fwroot/ for the clock's pull OTA")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--root", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "fwroot"))
+    parser.add_argument("--rate", type=float, help="limit to this many KB/s")
+    parser.add_argument("--fail-after", type=int, help="drop the connection after this many bytes")
+    parser.add_argument("--no-length", action="store_true", help="leave out Content-Length")
+    args = parser.parse_args()
+
+    server = http.server.ThreadingHTTPServer(("", args.port), make_handler(args))
+    print(f"Serving {args.root} on port {args.port}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
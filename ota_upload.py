@@ -0,0 +1,125 @@
+import argparse
+import http.client
+import json
+import sys
+import time
+import uuid
+import zlib
+from urllib.parse import urlparse
+
+# Uploads firmware through the clock's resumable chunked API (/api/ota/upload).
+# Every chunk carries its offset and CRC-32, and the clock keeps what it has
+# committed when a connection drops, so the upload picks up where it stopped
+# instead of starting over. Rerunning the script after it gave up resumes too.
+#
+#   python ota_upload.py http://bedroomclock.local fwroot/firmware.bin.gz
+#   python ota_upload.py http://192.168.1.50 firmware.bin --chunk 2048 --restart
+
+CHUNK_SIZE = 4096       # OTA_UPLOAD_CHUNK_MAX on the clock
+
+
+def post_chunk(host, port, query, data, timeout):
+    boundary = uuid.uuid4().hex
+    body = (f"--{boundary}\r\n"
+            f'Content-Disposition: form-data; name="chunk"; filename="chunk.bin"\r\n'
+            f"Content-Type: application/octet-stream\r\n\r\n").encode() + data + f"\r\n--{boundary}--\r\n".encode()
+    connection = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        connection.request("POST", "/api/ota/upload?" + query, body=body,
+                           headers={"Content-Type": f"multipart/form-data; boundary={boundary}",
+                                    "Connection": "close"})
+        response = connection.getresponse()
+        return response.status, json.loads(response.read() or b"{}")
+    finally:
+        connection.close()
+
+
+def get_status(host, port, timeout):
+    connection = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        connection.request("GET", "/api/ota/upload", headers={"Connection": "close"})
+        response = connection.getresponse()
+        return json.loads(response.read())
+    finally:
+        connection.close()
+
+
+def upload(host, port, image, chunk_size, restart, retries, timeout):
+    image_crc = f"{zlib.crc32(image):08x}"
+
+    # Resume only an upload of this very image, anything else starts from 0
+    offset = 0
+    status = get_status(host, port, timeout)
+    if not restart and status.get("active") and status.get("size") == len(image) and status.get("image") == image_crc:
+        offset = status["offset"]
+        print(f"Resuming at {offset} of {len(image)} bytes")
+
+    start = time.monotonic()
+    sent_from = offset
+    failures = 0
+    while True:
+        chunk = image[offset:offset + chunk_size]
+        query = f"offset={offset}&size={len(image)}&crc={zlib.crc32(chunk):08x}&image={image_crc}"
+        try:
+            code, reply = post_chunk(host, port, query, chunk, timeout)
+        except (OSError, http.client.HTTPException) as e:
+            failures += 1
+            if failures > retries:
+                print(f"\nGiving up after {retries} retries ({e}), run again to resume")
+                return False
+            print(f"\nConnection failed at {offset} ({e}), retrying")
+            time.sleep(min(2 ** failures, 10))
+            # The chunk may have been committed before the connection dropped
+            try:
+                status = get_status(host, port, timeout)
+            except (OSError, http.client.HTTPException, ValueError):
+                continue
+            if status.get("done"):
+                print("\nUpload complete, the clock is restarting")
+                return True
+            offset = status.get("offset", offset)
+            continue
+
+        if code == 200:
+            failures = 0
+            offset = reply["offset"]
+        elif code in (409, 422):
+            # Out of step, a corrupted chunk or a lost session: carry on from what the clock has
+            failures += 1
+            offset = reply.get("offset", 0)
+        else:
+            print(f"\nUpload failed: HTTP {code} {reply.get('error', '')}")
+            return False
+        if failures > retries:
+            print(f"\nGiving up after {retries} retries, run again to resume")
+            return False
+
+        elapsed = time.monotonic() - start
+        rate = (offset - sent_from) / 1024 / elapsed if elapsed else 0
+        print(f"\r{offset} of {len(image)} bytes, {rate:.1f} KB/s ", end="", flush=True)
+        if reply.get("done"):
+            print("\nUpload complete, the clock is restarting")
+            return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Resumable firmware upload to the clock")
+    parser.add_argument("url", help="the clock, e.g. http://bedroomclock.local")
+    parser.add_argument("firmware", help="firmware.bin or firmware.bin.gz")
+    parser.add_argument("--chunk", type=int, default=CHUNK_SIZE, help="bytes per request")
+    parser.add_argument("--restart", action="store_true", help="start over even if an upload can be resumed")
+    parser.add_argument("--retries", type=int, default=8, help="consecutive failures before giving up")
+    parser.add_argument("--timeout", type=float, default=15)
+    args = parser.parse_args()
+
+    if not 0 < args.chunk <= CHUNK_SIZE:
+        parser.error(f"--chunk must be between 1 and {CHUNK_SIZE}")
+    url = urlparse(args.url)
+    with open(args.firmware, "rb") as f:
+        image = f.read()
+    ok = upload(url.hostname, url.port or 80, image, args.chunk, args.restart, args.retries, args.timeout)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
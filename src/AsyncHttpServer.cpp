@@ -0,0 +1,1017 @@
+#include "AsyncHttpServer.h"
+
+extern "C" {
+#include <lwip/tcp.h>
+}
+
+#define HTTP_LENGTH_NOT_SET ((size_t)-2)
+#define CHUNK_HEADER_ROOM 6         // "5fa\r\n" fits in front of a source piece in buf
+#define CHUNK_FRAMING 8             // Header room plus the trailing "\r\n"
+#define SOURCE_MIN_ROOM 64          // Smaller pieces than this are not worth the framing
+
+// Sent straight from the accept callback when every pool slot is taken
+static const char busyResponse[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Retry-After: 1\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n\r\n";
+
+static const char* statusText(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "";
+    }
+}
+
+static bool startsWithIgnoreCase(const char* text, const char* prefix) {
+    return text && strncasecmp(text, prefix, strlen(prefix)) == 0;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decodes %XX and '+' in place
+static void urlDecode(char* text) {
+    char* out = text;
+    for (char* in = text; *in; in++) {
+        if (*in == '+') {
+            *out++ = ' ';
+        } else if (*in == '%' && hexValue(in[1]) >= 0 && hexValue(in[2]) >= 0) {
+            *out++ = (char)(hexValue(in[1]) * 16 + hexValue(in[2]));
+            in += 2;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+AsyncHttpServer::AsyncHttpServer(uint16_t port)
+    : _port(port), _listener(nullptr), _routeCount(0), _rejected(0),
+      _sliceStart(0), _sliceBudget(0), _nextSlot(0), _current(nullptr), _contentLength(HTTP_LENGTH_NOT_SET), _extraHeadersLength(0), _headersSent(false),
+      _chunked(false), _responseEnded(false), _writer(*this) {
+    for (Connection& c : _pool) {
+        c.pcb = nullptr;
+        c.rx = nullptr;
+        c.state = CONN_FREE;
+        c.generation = 0;
+    }
+}
+
+void AsyncHttpServer::begin() {
+    tcp_pcb* pcb = tcp_new();
+    if (!pcb) {
+        return;
+    }
+    if (tcp_bind(pcb, IP_ADDR_ANY, _port) != ERR_OK) {
+        tcp_close(pcb);
+        return;
+    }
+    _listener = tcp_listen_with_backlog(pcb, HTTP_MAX_CONNECTIONS);
+    if (!_listener) {
+        tcp_close(pcb);
+        return;
+    }
+    tcp_arg(_listener, this);
+    tcp_accept(_listener, onAccept);
+}
+
+AsyncHttpServer& AsyncHttpServer::on(const char* uri, THandlerFunction handler) {
+    return on(uri, HTTP_ANY, handler);
+}
+
+AsyncHttpServer& AsyncHttpServer::on(const char* uri, HTTPMethod method, THandlerFunction handler) {
+    return on(uri, method, handler, nullptr);
+}
+
+AsyncHttpServer& AsyncHttpServer::on(const char* uri, HTTPMethod method, THandlerFunction handler,
+                                     THandlerFunction uploadHandler) {
+    if (_routeCount < HTTP_MAX_ROUTES) {
+        Route& route = _routes[_routeCount++];
+        route.uri = uri;
+        route.method = method;
+        route.handler = handler;
+        route.uploadHandler = uploadHandler;
+    }
+    return *this;
+}
+
+uint8_t AsyncHttpServer::activeConnections() const {
+    uint8_t count = 0;
+    for (const Connection& c : _pool) {
+        if (c.state != CONN_FREE) count++;
+    }
+    return count;
+}
+
+// lwIP callbacks - these run in the network stack's context, so they only
+// hand buffers over and never call into the application
+
+int8_t AsyncHttpServer::onAccept(void* arg, tcp_pcb* pcb, int8_t err) {
+    AsyncHttpServer* self = (AsyncHttpServer*)arg;
+    if (err != ERR_OK || !pcb) {
+        return ERR_OK;
+    }
+
+    for (Connection& c : self->_pool) {
+        if (c.state != CONN_FREE) {
+            continue;
+        }
+        c.pcb = pcb;
+        c.rx = nullptr;
+        c.rxOffset = 0;
+        c.state = CONN_HEAD;
+        c.peerClosed = false;
+        c.failed = false;
+        c.generation++;
+        c.http10 = false;
+        c.lastActivity = millis();
+        c.len = 0;
+        c.headLength = 0;
+        c.bodyRemaining = 0;
+        c.argCount = 0;
+        c.route = -1;
+        c.uri = "";
+        c.contentType = nullptr;
+        c.ifNoneMatch = nullptr;
+        c.partIsFile = false;
+
+        tcp_setprio(pcb, TCP_PRIO_MIN);
+        tcp_arg(pcb, &c);
+        tcp_recv(pcb, onReceive);
+        tcp_err(pcb, onError);
+        return ERR_OK;
+    }
+
+    // Pool exhausted
+    self->_rejected++;
+    tcp_write(pcb, busyResponse, sizeof(busyResponse) - 1, TCP_WRITE_FLAG_COPY);
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+int8_t AsyncHttpServer::onReceive(void* arg, tcp_pcb* pcb, pbuf* p, int8_t err) {
+    Connection* c = (Connection*)arg;
+    if (!p) {
+        if (c) c->peerClosed = true;
+        return ERR_OK;
+    }
+    if (!c) {
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+        return ERR_OK;
+    }
+
+    // Not acknowledged until handleClient() consumes it, which throttles the sender
+    if (c->rx) {
+        pbuf_cat(c->rx, p);
+    } else {
+        c->rx = p;
+        c->rxOffset = 0;
+    }
+    c->lastActivity = millis();
+    return ERR_OK;
+}
+
+void AsyncHttpServer::onError(void* arg, int8_t err) {
+    // lwIP has already freed the pcb, handleClient() releases the slot
+    Connection* c = (Connection*)arg;
+    if (c) {
+        c->pcb = nullptr;
+        c->failed = true;
+    }
+}
+
+void AsyncHttpServer::handleClient(uint32_t budgetUs) {
+    _sliceStart = micros();
+    _sliceBudget = budgetUs;
+
+    // The first connection always gets some work done, the others only while time is left
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        uint8_t slot = (_nextSlot + i) % HTTP_MAX_CONNECTIONS;
+        if (i > 0 && sliceExpired()) {
+            _nextSlot = slot;
+            return;
+        }
+
+        Connection& c = _pool[slot];
+        if (c.state == CONN_FREE) {
+            continue;
+        }
+        if (c.failed) {
+            release(c, false);
+            continue;
+        }
+
+        if (c.state == CONN_STREAM || c.state == CONN_RESPOND) {
+            // Nothing more is expected from the client, just keep the window open
+            if (c.rx) {
+                tcp_recved(c.pcb, c.rx->tot_len);
+                pbuf_free(c.rx);
+                c.rx = nullptr;
+            }
+            if (c.state == CONN_RESPOND) {
+                pump(c);
+            } else if (c.peerClosed) {
+                release(c, true);
+            }
+            continue;
+        }
+
+        consume(c);
+
+        if (c.state == CONN_READY) {
+            // A handler cannot be split, so it waits for a pass with time left
+            if (sliceExpired()) {
+                _nextSlot = slot;
+                return;
+            }
+            dispatch(c);
+        } else if (c.state != CONN_FREE && !c.failed &&
+                   (c.peerClosed || millis() - c.lastActivity > HTTP_REQUEST_TIMEOUT_MS)) {
+            release(c, true);
+        }
+    }
+    _nextSlot = (_nextSlot + 1) % HTTP_MAX_CONNECTIONS;
+}
+
+void AsyncHttpServer::consume(Connection& c) {
+    while (c.rx && (c.state == CONN_HEAD || c.state == CONN_BODY || c.state == CONN_UPLOAD)) {
+        pbuf* head = c.rx;
+        const char* data = (const char*)head->payload + c.rxOffset;
+        size_t available = head->len - c.rxOffset;
+        size_t used = 0;
+
+        if (c.state == CONN_HEAD) {
+            feedHead(c, data, available, used);
+        } else if (c.state == CONN_BODY) {
+            feedBody(c, data, available, used);
+        } else {
+            feedMultipart(c, data, available, used);
+        }
+
+        if (c.state == CONN_FREE || c.failed) {
+            return;
+        }
+
+        c.rxOffset += used;
+        if (c.rxOffset == head->len) {
+            // Same hand-over as the core's ClientContext: keep the rest of the chain, ack this part
+            uint16_t length = head->len;
+            c.rx = head->next;
+            c.rxOffset = 0;
+            if (c.rx) {
+                pbuf_ref(c.rx);
+            }
+            pbuf_free(head);
+            tcp_recved(c.pcb, length);
+        }
+
+        // Unacknowledged data stays queued and throttles the client until the next pass
+        if (sliceExpired()) {
+            return;
+        }
+    }
+}
+
+bool AsyncHttpServer::feedHead(Connection& c, const char* data, size_t length, size_t& used) {
+    while (used < length) {
+        if (c.len >= HTTP_CONNECTION_BUFFER - 1) {
+            sendError(c, 431, "Request head too large");
+            return false;
+        }
+        c.buf[c.len++] = data[used++];
+        if (c.len >= 4 && memcmp(c.buf + c.len - 4, "\r\n\r\n", 4) == 0) {
+            c.headLength = c.len;
+            return parseHead(c);
+        }
+    }
+    return true;
+}
+
+bool AsyncHttpServer::parseHead(Connection& c) {
+    // Terminate every line in place, the request then lives in buf as C strings
+    c.buf[c.headLength - 2] = '\0';
+
+    char* line = c.buf;
+    char* next = strstr(line, "\r\n");
+    if (next) {
+        *next = '\0';
+        next += 2;
+    }
+
+    // Request line: METHOD URI HTTP/1.x
+    char* method = line;
+    char* uri = strchr(method, ' ');
+    if (!uri) {
+        sendError(c, 400, "Bad request");
+        return false;
+    }
+    *uri++ = '\0';
+    char* version = strchr(uri, ' ');
+    if (version) {
+        *version++ = '\0';
+    }
+    c.http10 = version && strcmp(version, "HTTP/1.0") == 0;
+
+    if (strcmp(method, "GET") == 0) c.method = HTTP_GET;
+    else if (strcmp(method, "POST") == 0) c.method = HTTP_POST;
+    else if (strcmp(method, "HEAD") == 0) c.method = HTTP_HEAD;
+    else if (strcmp(method, "PUT") == 0) c.method = HTTP_PUT;
+    else if (strcmp(method, "PATCH") == 0) c.method = HTTP_PATCH;
+    else if (strcmp(method, "DELETE") == 0) c.method = HTTP_DELETE;
+    else if (strcmp(method, "OPTIONS") == 0) c.method = HTTP_OPTIONS;
+    else {
+        sendError(c, 400, "Unsupported method");
+        return false;
+    }
+
+    char* query = strchr(uri, '?');
+    if (query) {
+        *query++ = '\0';
+        parseArgs(c, query);
+    }
+    c.uri = uri;
+
+    // Headers, only the few the routes need are kept
+    size_t contentLength = 0;
+    while (next && *next) {
+        line = next;
+        next = strstr(line, "\r\n");
+        if (next) {
+            *next = '\0';
+            next += 2;
+        }
+        char* value = strchr(line, ':');
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+        while (*value == ' ') value++;
+
+        if (strcasecmp(line, "Content-Length") == 0) contentLength = strtoul(value, nullptr, 10);
+        else if (strcasecmp(line, "Content-Type") == 0) c.contentType = value;
+        else if (strcasecmp(line, "If-None-Match") == 0) c.ifNoneMatch = value;
+    }
+
+    c.route = -1;
+    for (uint8_t i = 0; i < _routeCount; i++) {
+        if (strcmp(_routes[i].uri, c.uri) == 0 &&
+            (_routes[i].method == HTTP_ANY || _routes[i].method == c.method)) {
+            c.route = i;
+            break;
+        }
+    }
+
+    if (startsWithIgnoreCase(c.contentType, "multipart/form-data")) {
+        const char* boundary = strstr(c.contentType, "boundary=");
+        if (!boundary) {
+            sendError(c, 400, "Missing multipart boundary");
+            return false;
+        }
+        boundary += 9;
+        size_t boundaryLength = strcspn(boundary, "\";");
+        if (*boundary == '"') {
+            boundary++;
+            boundaryLength = strcspn(boundary, "\"");
+        }
+        if (boundaryLength == 0 || boundaryLength + 4 >= sizeof(c.delimiter)) {
+            sendError(c, 400, "Bad multipart boundary");
+            return false;
+        }
+        for (const Connection& other : _pool) {
+            if (&other != &c && other.state == CONN_UPLOAD) {
+                sendError(c, 503, "Another upload is in progress");
+                return false;
+            }
+        }
+        memcpy(c.delimiter, "\r\n--", 4);
+        memcpy(c.delimiter + 4, boundary, boundaryLength);
+        c.delimiterLength = boundaryLength + 4;
+        // The body opens with the boundary without a leading CRLF
+        c.delimiterMatched = 2;
+        c.partState = PART_DATA;
+        c.partIsFile = false;
+        c.partName = nullptr;
+        c.partValue = nullptr;
+        _upload.contentLength = contentLength;
+        c.state = CONN_UPLOAD;
+    } else if (contentLength > 0) {
+        if (contentLength > (size_t)(HTTP_CONNECTION_BUFFER - 1 - c.len)) {
+            sendError(c, 413, "Request body too large");
+            return false;
+        }
+        c.bodyRemaining = contentLength;
+        c.state = CONN_BODY;
+    } else {
+        c.state = CONN_READY;
+    }
+    return true;
+}
+
+void AsyncHttpServer::feedBody(Connection& c, const char* data, size_t length, size_t& used) {
+    used = length < c.bodyRemaining ? length : c.bodyRemaining;
+    memcpy(c.buf + c.len, data, used);
+    c.len += used;
+    c.bodyRemaining -= used;
+    if (c.bodyRemaining > 0) {
+        return;
+    }
+
+    c.buf[c.len] = '\0';
+    char* body = c.buf + c.headLength;
+    if (startsWithIgnoreCase(c.contentType, "application/x-www-form-urlencoded")) {
+        parseArgs(c, body);
+    } else {
+        addArg(c, "plain", body);
+    }
+    c.state = CONN_READY;
+}
+
+void AsyncHttpServer::parseArgs(Connection& c, char* text) {
+    while (text && *text) {
+        char* next = strchr(text, '&');
+        if (next) {
+            *next++ = '\0';
+        }
+        char* value = strchr(text, '=');
+        if (value) {
+            *value++ = '\0';
+        } else {
+            value = text + strlen(text);
+        }
+        urlDecode(text);
+        urlDecode(value);
+        if (*text) {
+            addArg(c, text, value);
+        }
+        text = next;
+    }
+}
+
+bool AsyncHttpServer::addArg(Connection& c, const char* name, const char* value) {
+    if (c.argCount >= HTTP_MAX_ARGS) {
+        return false;
+    }
+    c.args[c.argCount].name = name;
+    c.args[c.argCount].value = value;
+    c.argCount++;
+    return true;
+}
+
+bool AsyncHttpServer::hasArg(const char* name) const {
+    if (!_current) {
+        return false;
+    }
+    for (uint8_t i = 0; i < _current->argCount; i++) {
+        if (strcmp(_current->args[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+String AsyncHttpServer::arg(const char* name) const {
+    if (_current) {
+        for (uint8_t i = 0; i < _current->argCount; i++) {
+            if (strcmp(_current->args[i].name, name) == 0) {
+                return String(_current->args[i].value);
+            }
+        }
+    }
+    return String();
+}
+
+String AsyncHttpServer::header(const char* name) const {
+    const char* value = nullptr;
+    if (_current) {
+        if (strcasecmp(name, "Content-Type") == 0) value = _current->contentType;
+        else if (strcasecmp(name, "If-None-Match") == 0) value = _current->ifNoneMatch;
+    }
+    return String(value ? value : "");
+}
+
+// Multipart bodies are parsed as they arrive: file parts go to the route's upload
+// handler in HTTPUpload-sized pieces, small fields are collected into buf as args
+
+void AsyncHttpServer::feedMultipart(Connection& c, const char* data, size_t length, size_t& used) {
+    // The upload handler needs the request's args and upload() while it runs
+    _current = &c;
+    while (used < length && c.partState != PART_DONE) {
+        multipartByte(c, (uint8_t)data[used++]);
+    }
+    _current = nullptr;
+
+    if (c.partState == PART_DONE) {
+        used = length;      // Ignore the epilogue
+        c.state = CONN_READY;
+    }
+}
+
+void AsyncHttpServer::multipartByte(Connection& c, uint8_t b) {
+    if (c.partState == PART_DATA) {
+        if (b == (uint8_t)c.delimiter[c.delimiterMatched]) {
+            if (++c.delimiterMatched == c.delimiterLength) {
+                endPart(c);
+                c.delimiterMatched = 0;
+                c.partState = PART_DELIMITER_TAIL;
+            }
+            return;
+        }
+
+        // Not a delimiter after all, the matched bytes were data. Boundaries cannot
+        // contain CR, so only the current byte can start a new match.
+        for (uint8_t i = 0; i < c.delimiterMatched; i++) {
+            partByte(c, (uint8_t)c.delimiter[i]);
+        }
+        c.delimiterMatched = 0;
+        if (b == (uint8_t)c.delimiter[0]) {
+            c.delimiterMatched = 1;
+        } else {
+            partByte(c, b);
+        }
+        return;
+    }
+
+    if (c.partState == PART_DELIMITER_TAIL) {
+        // "--" closes the body, CRLF starts the next part's headers
+        if (b == '-') {
+            c.partState = PART_DONE;
+        } else if (b == '\n') {
+            c.partState = PART_HEADERS;
+            c.partIsFile = false;
+            c.partName = nullptr;
+            c.partValue = nullptr;
+            c.lineLength = 0;
+        }
+        return;
+    }
+
+    if (c.partState == PART_HEADERS) {
+        // Header lines are collected just past the committed part of buf
+        char* line = c.buf + c.len;
+        if (b == '\n') {
+            if (c.lineLength > 0 && line[c.lineLength - 1] == '\r') c.lineLength--;
+            line[c.lineLength] = '\0';
+            bool blank = c.lineLength == 0;
+            c.lineLength = 0;
+            if (blank) {
+                beginPart(c);
+                c.partState = PART_DATA;
+            } else {
+                multipartHeaderLine(c, line);
+            }
+        } else if (c.len + c.lineLength < HTTP_CONNECTION_BUFFER - 1) {
+            line[c.lineLength++] = (char)b;
+        }
+    }
+}
+
+void AsyncHttpServer::partByte(Connection& c, uint8_t b) {
+    if (c.partIsFile) {
+        if (_upload.currentSize == sizeof(_upload.buf)) {
+            _upload.status = UPLOAD_FILE_WRITE;
+            if (c.route >= 0 && _routes[c.route].uploadHandler) {
+                _routes[c.route].uploadHandler();
+            }
+            _upload.totalSize += _upload.currentSize;
+            _upload.currentSize = 0;
+        }
+        _upload.buf[_upload.currentSize++] = b;
+    } else if (c.partValue && c.len < HTTP_CONNECTION_BUFFER - 1) {
+        c.buf[c.len++] = (char)b;
+    }
+}
+
+void AsyncHttpServer::multipartHeaderLine(Connection& c, char* line) {
+    if (startsWithIgnoreCase(line, "Content-Type:")) {
+        const char* value = line + 13;
+        while (*value == ' ') value++;
+        _upload.type = value;
+        return;
+    }
+    if (!startsWithIgnoreCase(line, "Content-Disposition:")) {
+        return;
+    }
+
+    // Find both before terminating either, they may come in any order
+    char* filename = strstr(line, "filename=\"");
+    char* name = strstr(line, " name=\"");
+    if (!name) name = strstr(line, ";name=\"");
+    if (filename) {
+        filename += 10;
+        char* end = strchr(filename, '"');
+        if (end) *end = '\0';
+    }
+    if (name) {
+        name += 7;
+        char* end = strchr(name, '"');
+        if (end) *end = '\0';
+    }
+
+    if (filename) {
+        _upload.filename = filename;
+        c.partIsFile = true;
+    }
+    if (name) {
+        _upload.name = name;
+        if (!c.partIsFile) {
+            // Keep the field name for its arg by committing it to buf
+            size_t nameLength = strlen(name);
+            memmove(c.buf + c.len, name, nameLength + 1);
+            c.partName = c.buf + c.len;
+            c.len += nameLength + 1;
+        }
+    }
+}
+
+void AsyncHttpServer::beginPart(Connection& c) {
+    if (c.partIsFile) {
+        _upload.status = UPLOAD_FILE_START;
+        _upload.totalSize = 0;
+        _upload.currentSize = 0;
+        if (c.route >= 0 && _routes[c.route].uploadHandler) {
+            _routes[c.route].uploadHandler();
+        }
+    } else if (c.partName) {
+        c.partValue = c.buf + c.len;
+    }
+}
+
+void AsyncHttpServer::endPart(Connection& c) {
+    if (c.partIsFile) {
+        bool hasHandler = c.route >= 0 && _routes[c.route].uploadHandler;
+        if (_upload.currentSize > 0) {
+            _upload.status = UPLOAD_FILE_WRITE;
+            if (hasHandler) _routes[c.route].uploadHandler();
+            _upload.totalSize += _upload.currentSize;
+            _upload.currentSize = 0;
+        }
+        _upload.status = UPLOAD_FILE_END;
+        if (hasHandler) _routes[c.route].uploadHandler();
+        c.partIsFile = false;
+    } else if (c.partValue && c.len < HTTP_CONNECTION_BUFFER) {
+        c.buf[c.len++] = '\0';
+        addArg(c, c.partName, c.partValue);
+    }
+    c.partName = nullptr;
+    c.partValue = nullptr;
+}
+
+void AsyncHttpServer::dispatch(Connection& c) {
+    _current = &c;
+    _contentLength = HTTP_LENGTH_NOT_SET;
+    _extraHeadersLength = 0;
+    _headersSent = false;
+    _chunked = false;
+    _responseEnded = false;
+
+    if (c.route >= 0) {
+        _routes[c.route].handler();
+    } else {
+        send(404, "text/plain", "Not found");
+    }
+
+    if (c.state == CONN_STREAM || c.state == CONN_RESPOND) {
+        if (c.pcb) {
+            tcp_output(c.pcb);
+        }
+        _current = nullptr;
+        if (c.state == CONN_RESPOND && !sliceExpired()) {
+            pump(c);
+        }
+        return;
+    }
+
+    finishResponse();
+    _current = nullptr;
+    release(c, true);
+}
+
+uint16_t AsyncHttpServer::detachStream() {
+    if (!_current || !_current->pcb) {
+        return 0;
+    }
+    _current->state = CONN_STREAM;
+    _headersSent = true;
+    return ((uint16_t)_current->generation << 8) | (uint16_t)(_current - _pool + 1);
+}
+
+AsyncHttpServer::Connection* AsyncHttpServer::streamConnection(uint16_t handle) const {
+    uint8_t slot = handle & 0xFF;
+    if (slot == 0 || slot > HTTP_MAX_CONNECTIONS) {
+        return nullptr;
+    }
+    Connection* c = const_cast<Connection*>(&_pool[slot - 1]);
+    if (c->state != CONN_STREAM || c->generation != (handle >> 8) || !c->pcb) {
+        return nullptr;
+    }
+    return c;
+}
+
+bool AsyncHttpServer::streamConnected(uint16_t handle) const {
+    return streamConnection(handle) != nullptr;
+}
+
+bool AsyncHttpServer::streamWrite(uint16_t handle, const char* data, size_t length) {
+    Connection* c = streamConnection(handle);
+    // Never wait here: a subscriber that cannot take the whole message is too slow
+    if (!c || tcp_sndbuf(c->pcb) < length) {
+        return false;
+    }
+    if (tcp_write(c->pcb, data, length, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        return false;
+    }
+    tcp_output(c->pcb);
+    return true;
+}
+
+void AsyncHttpServer::streamClose(uint16_t handle) {
+    Connection* c = streamConnection(handle);
+    if (c) {
+        release(*c, true);
+    }
+}
+
+void AsyncHttpServer::sendError(Connection& c, int code, const char* message) {
+    _current = &c;
+    _contentLength = HTTP_LENGTH_NOT_SET;
+    _extraHeadersLength = 0;
+    _headersSent = false;
+    _chunked = false;
+    _responseEnded = false;
+    send(code, "text/plain", message);
+    finishResponse();
+    _current = nullptr;
+    release(c, true);
+}
+
+void AsyncHttpServer::sendHeaders(int code, const char* contentType, size_t contentLength, const char* extraHeaders) {
+    if (!_current || _headersSent) {
+        return;
+    }
+    _headersSent = true;
+
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.%d %d %s\r\nContent-Type: %s\r\n",
+                     _current->http10 ? 0 : 1, code, statusText(code), contentType ? contentType : "text/html");
+    if (contentLength == CONTENT_LENGTH_UNKNOWN) {
+        // HTTP/1.0 clients just read until we close
+        _chunked = !_current->http10;
+        if (_chunked) {
+            n += snprintf(head + n, sizeof(head) - n, "Transfer-Encoding: chunked\r\n");
+        }
+    } else {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %u\r\n", (unsigned)contentLength);
+    }
+    writeRaw((const uint8_t*)head, n);
+    if (extraHeaders) {
+        writeRaw((const uint8_t*)extraHeaders, strlen(extraHeaders));
+    }
+    writeRaw((const uint8_t*)"Connection: close\r\n\r\n", 21);
+}
+
+void AsyncHttpServer::sendHeader(const char* name, const char* value) {
+    size_t room = sizeof(_extraHeaders) - _extraHeadersLength;
+    int n = snprintf(_extraHeaders + _extraHeadersLength, room, "%s: %s\r\n", name, value);
+    if (n > 0 && (size_t)n < room) {
+        _extraHeadersLength += n;
+    }
+}
+
+void AsyncHttpServer::send(int code, const char* contentType, const char* content) {
+    size_t length = strlen(content);
+    _extraHeaders[_extraHeadersLength] = '\0';
+    sendHeaders(code, contentType, _contentLength == HTTP_LENGTH_NOT_SET ? length : _contentLength, _extraHeaders);
+    if (length > 0) {
+        sendContent(content, length);
+    }
+}
+
+void AsyncHttpServer::send(int code, const char* contentType, const String& content) {
+    send(code, contentType, content.c_str());
+}
+
+void AsyncHttpServer::sendContent(const char* content, size_t length) {
+    if (!_current || _responseEnded) {
+        return;
+    }
+    if (_chunked && length == 0) {
+        writeRaw((const uint8_t*)"0\r\n\r\n", 5);
+        _responseEnded = true;
+        return;
+    }
+    writeBody((const uint8_t*)content, length);
+}
+
+void AsyncHttpServer::sendContentSource(TContentSource source) {
+    if (!_current || _responseEnded || !_current->pcb) {
+        return;
+    }
+    Connection& c = *_current;
+    _responseEnded = true;
+
+    // Write straight away while the send buffer has room and the slice has time,
+    // so short pages are complete before the handler returns
+    uint8_t chunk[256];
+    while (c.pcb && !sliceExpired() && tcp_sndbuf(c.pcb) >= sizeof(chunk) + CHUNK_FRAMING) {
+        size_t n = source(chunk, sizeof(chunk));
+        if (n == 0) {
+            if (_chunked) {
+                writeRaw((const uint8_t*)"0\r\n\r\n", 5);
+            }
+            return;
+        }
+        writeBody(chunk, n);
+    }
+
+    // The rest goes out from handleClient() as the client takes it
+    c.source = std::move(source);
+    c.chunked = _chunked;
+    c.pendingStart = 0;
+    c.pendingLength = 0;
+    c.lastActivity = millis();
+    c.state = CONN_RESPOND;
+}
+
+void AsyncHttpServer::writeBody(const uint8_t* data, size_t length) {
+    if (!_chunked) {
+        writeRaw(data, length);
+        return;
+    }
+    char size[12];
+    int n = snprintf(size, sizeof(size), "%x\r\n", (unsigned)length);
+    writeRaw((const uint8_t*)size, n);
+    writeRaw(data, length);
+    writeRaw((const uint8_t*)"\r\n", 2);
+}
+
+// Moves a content source's output into the send buffer while it has room and the
+// slice has time. The piece in buf is framed in place and kept until lwIP takes it.
+void AsyncHttpServer::pump(Connection& c) {
+    while (c.pcb) {
+        if (c.pendingLength == 0) {
+            if (!c.source) {
+                tcp_output(c.pcb);
+                release(c, true);
+                return;
+            }
+
+            size_t room = tcp_sndbuf(c.pcb);
+            if (room < SOURCE_MIN_ROOM) {
+                break;
+            }
+            if (room > sizeof(c.buf)) {
+                room = sizeof(c.buf);
+            }
+            size_t n = c.source((uint8_t*)c.buf + CHUNK_HEADER_ROOM, room - CHUNK_FRAMING);
+
+            if (n == 0) {
+                c.source = nullptr;
+                if (c.chunked) {
+                    memcpy(c.buf, "0\r\n\r\n", 5);
+                    c.pendingLength = 5;
+                }
+                c.pendingStart = 0;
+                continue;
+            }
+
+            c.pendingStart = CHUNK_HEADER_ROOM;
+            c.pendingLength = n;
+            if (c.chunked) {
+                char size[8];
+                int header = snprintf(size, sizeof(size), "%x\r\n", (unsigned)n);
+                c.pendingStart -= header;
+                memcpy(c.buf + c.pendingStart, size, header);
+                memcpy(c.buf + CHUNK_HEADER_ROOM + n, "\r\n", 2);
+                c.pendingLength += header + 2;
+            }
+        }
+
+        // Out of memory for segments: keep the piece and try again next pass
+        if (tcp_write(c.pcb, c.buf + c.pendingStart, c.pendingLength, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            break;
+        }
+        c.pendingLength = 0;
+        c.lastActivity = millis();
+
+        if (sliceExpired()) {
+            break;
+        }
+    }
+
+    if (!c.pcb) {
+        return;
+    }
+    tcp_output(c.pcb);
+    if (millis() - c.lastActivity > HTTP_WRITE_TIMEOUT_MS) {
+        release(c, false);
+    }
+}
+
+void AsyncHttpServer::sendContent_P(PGM_P content, size_t length) {
+    if (!_current || _responseEnded || length == 0) {
+        return;
+    }
+    if (_chunked) {
+        char size[12];
+        int n = snprintf(size, sizeof(size), "%x\r\n", (unsigned)length);
+        writeRaw((const uint8_t*)size, n);
+    }
+    // lwIP copies with plain memcpy, so flash has to go through RAM first
+    uint8_t chunk[128];
+    while (length > 0) {
+        size_t n = length < sizeof(chunk) ? length : sizeof(chunk);
+        memcpy_P(chunk, content, n);
+        writeRaw(chunk, n);
+        content += n;
+        length -= n;
+    }
+    if (_chunked) {
+        writeRaw((const uint8_t*)"\r\n", 2);
+    }
+}
+
+size_t AsyncHttpServer::writeRaw(const uint8_t* data, size_t length) {
+    Connection* c = _current;
+    size_t written = 0;
+    uint32_t waitStart = millis();
+
+    while (written < length && c && c->pcb) {
+        size_t room = tcp_sndbuf(c->pcb);
+        size_t n = length - written;
+        if (n > room) n = room;
+        if (n > 0 && tcp_write(c->pcb, data + written, n, TCP_WRITE_FLAG_COPY) == ERR_OK) {
+            written += n;
+            waitStart = millis();
+            continue;
+        }
+
+        // Send buffer full: push what is queued and let lwIP process ACKs
+        tcp_output(c->pcb);
+        if (millis() - waitStart > HTTP_WRITE_TIMEOUT_MS) {
+            tcp_abort(c->pcb);     // onError() clears c->pcb
+            break;
+        }
+        delay(1);
+    }
+    return written;
+}
+
+void AsyncHttpServer::finishResponse() {
+    if (!_current) {
+        return;
+    }
+    if (!_headersSent) {
+        send(500, "text/plain", "Handler sent no response");
+    }
+    if (_chunked && !_responseEnded) {
+        sendContent("", 0);
+    }
+    if (_current->pcb) {
+        tcp_output(_current->pcb);
+    }
+}
+
+void AsyncHttpServer::release(Connection& c, bool graceful) {
+    if (c.state == CONN_UPLOAD && c.partIsFile) {
+        _upload.status = UPLOAD_FILE_ABORTED;
+        if (c.route >= 0 && _routes[c.route].uploadHandler) {
+            _current = &c;
+            _routes[c.route].uploadHandler();
+            _current = nullptr;
+        }
+    }
+
+    if (c.pcb) {
+        tcp_arg(c.pcb, nullptr);
+        tcp_recv(c.pcb, nullptr);
+        tcp_err(c.pcb, nullptr);
+        // A graceful close still delivers what is queued; lwIP owns the pcb from here
+        if (!graceful || tcp_close(c.pcb) != ERR_OK) {
+            tcp_abort(c.pcb);
+        }
+        c.pcb = nullptr;
+    }
+    if (c.rx) {
+        pbuf_free(c.rx);
+        c.rx = nullptr;
+    }
+    c.source = nullptr;
+    c.state = CONN_FREE;
+}
@@ -0,0 +1,144 @@
+#include "BootProfiler.h"
+#include "WiFiSetup.h"
+
+#define BOOT_RECORD_MAGIC 0xB007
+
+static const char* const bootPhaseNames[BOOT_PHASE_COUNT] = {
+    "display", "littlefs", "wifi", "ota", "config", "time", "webserver", "ntfy", "mqtt"
+};
+
+static BootRecord currentBoot;
+static uint32_t setupStartMicros = 0;
+static uint32_t phaseStartMicros[BOOT_PHASE_COUNT];
+
+// Oldest first, the current boot is appended once setup() finishes
+static BootRecord bootHistory[BOOT_PROFILE_HISTORY];
+static uint8_t bootHistoryCount = 0;
+
+const char* bootPhaseName(BootPhase phase) {
+    return phase < BOOT_PHASE_COUNT ? bootPhaseNames[phase] : "unknown";
+}
+
+void bootProfileStart() {
+    memset(&currentBoot, 0, sizeof(currentBoot));
+    memset(phaseStartMicros, 0, sizeof(phaseStartMicros));
+    setupStartMicros = micros();
+}
+
+void bootPhaseBegin(BootPhase phase) {
+    if (phase < BOOT_PHASE_COUNT) {
+        phaseStartMicros[phase] = micros();
+    }
+}
+
+void bootPhaseEnd(BootPhase phase) {
+    if (phase < BOOT_PHASE_COUNT) {
+        currentBoot.phase_us[phase] = micros() - phaseStartMicros[phase];
+    }
+}
+
+static void loadBootHistory() {
+    bootHistoryCount = 0;
+
+    File file = LittleFS.open(BOOT_PROFILE_FILE, "r");
+    if (!file) {
+        return;
+    }
+
+    BootRecord record;
+    while (bootHistoryCount < BOOT_PROFILE_HISTORY &&
+           file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+        if (record.magic != BOOT_RECORD_MAGIC || record.phase_count != BOOT_PHASE_COUNT) {
+            // Written by a firmware with a different phase list - start over
+            bootHistoryCount = 0;
+            break;
+        }
+        bootHistory[bootHistoryCount++] = record;
+    }
+    file.close();
+}
+
+static void saveBootHistory() {
+    File file = LittleFS.open(BOOT_PROFILE_FILE, "w");
+    if (!file) {
+        printBoth("Failed to open boot profile file for writing");
+        return;
+    }
+    file.write((const uint8_t*)bootHistory, bootHistoryCount * sizeof(BootRecord));
+    file.close();
+}
+
+void bootProfileFinish() {
+    currentBoot.total_us = micros() - setupStartMicros;
+    currentBoot.magic = BOOT_RECORD_MAGIC;
+    currentBoot.phase_count = BOOT_PHASE_COUNT;
+    currentBoot.version = version;
+
+    loadBootHistory();
+    currentBoot.sequence = bootHistoryCount > 0 ? bootHistory[bootHistoryCount - 1].sequence + 1 : 1;
+
+    if (bootHistoryCount == BOOT_PROFILE_HISTORY) {
+        // Drop the oldest boot
+        memmove(&bootHistory[0], &bootHistory[1], (BOOT_PROFILE_HISTORY - 1) * sizeof(BootRecord));
+        bootHistoryCount--;
+    }
+    bootHistory[bootHistoryCount++] = currentBoot;
+    saveBootHistory();
+
+    printBothf("Boot completed in %lu ms", (unsigned long)(currentBoot.total_us / 1000));
+}
+
+void printBootProfile(Print& out) {
+    if (bootHistoryCount == 0) {
+        out.println("No boot timings recorded yet");
+        return;
+    }
+
+    // One column per boot, newest on the right, times in ms
+    out.printf("%-10s", "boot");
+    for (uint8_t i = 0; i < bootHistoryCount; i++) {
+        out.printf("%9lu", (unsigned long)bootHistory[i].sequence);
+    }
+    out.println();
+    out.printf("%-10s", "version");
+    for (uint8_t i = 0; i < bootHistoryCount; i++) {
+        out.printf("%9.2f", bootHistory[i].version);
+    }
+    out.println();
+    for (uint8_t phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        out.printf("%-10s", bootPhaseNames[phase]);
+        for (uint8_t i = 0; i < bootHistoryCount; i++) {
+            out.printf("%9.1f", bootHistory[i].phase_us[phase] / 1000.0);
+        }
+        out.println();
+    }
+    out.printf("%-10s", "total");
+    for (uint8_t i = 0; i < bootHistoryCount; i++) {
+        out.printf("%9.1f", bootHistory[i].total_us / 1000.0);
+    }
+    out.println();
+}
+
+void handleBootProfile() {
+    DynamicJsonDocument doc(3072);
+
+    JsonArray phases = doc.createNestedArray("phases");
+    for (uint8_t phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        phases.add(bootPhaseNames[phase]);
+    }
+
+    JsonArray boots = doc.createNestedArray("boots");
+    for (uint8_t i = 0; i < bootHistoryCount; i++) {
+        const BootRecord& record = bootHistory[i];
+        JsonObject boot = boots.createNestedObject();
+        boot["sequence"] = record.sequence;
+        boot["version"] = record.version;
+        boot["total_us"] = record.total_us;
+        JsonArray timings = boot.createNestedArray("phase_us");
+        for (uint8_t phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+            timings.add(record.phase_us[phase]);
+        }
+    }
+
+    sendJsonResponse(200, doc);
+}
@@ -0,0 +1,564 @@
+#include "ConfigApi.h"
+#include "WiFiSetup.h"
+#include "DeferredJobs.h"
+#include "TimeSync.h"
+
+static void setFieldError(String& error, const char* key, const char* problem) {
+    char message[80];
+    snprintf(message, sizeof(message), "%s %s", key, problem);
+    error = message;
+}
+
+// The readers below leave the field alone when key is absent and fail on a wrong type or range
+
+static bool readBool(JsonObjectConst obj, const char* key, bool& field, bool& changed, String& error) {
+    JsonVariantConst value = obj[key];
+    if (value.isNull()) {
+        return true;
+    }
+    if (!value.is<bool>()) {
+        setFieldError(error, key, "must be true or false");
+        return false;
+    }
+    changed |= updateField(field, value.as<bool>());
+    return true;
+}
+
+template <typename T>
+static bool readNumber(JsonObjectConst obj, const char* key, float minValue, float maxValue,
+                       T& field, bool& changed, String& error) {
+    JsonVariantConst value = obj[key];
+    if (value.isNull()) {
+        return true;
+    }
+    if (!value.is<float>()) {
+        setFieldError(error, key, "must be a number");
+        return false;
+    }
+    float number = value.as<float>();
+    if (number < minValue || number > maxValue) {
+        char problem[48];
+        snprintf(problem, sizeof(problem), "must be between %g and %g", minValue, maxValue);
+        setFieldError(error, key, problem);
+        return false;
+    }
+    changed |= updateField(field, value.as<T>());
+    return true;
+}
+
+static bool readString(JsonObjectConst obj, const char* key, char* field, size_t size, size_t minLength,
+                       bool& changed, String& error) {
+    JsonVariantConst value = obj[key];
+    if (value.isNull()) {
+        return true;
+    }
+    if (!value.is<const char*>()) {
+        setFieldError(error, key, "must be a string");
+        return false;
+    }
+    const char* text = value.as<const char*>();
+    size_t length = strlen(text);
+    if (length < minLength || length >= size) {
+        char problem[48];
+        snprintf(problem, sizeof(problem), "must be %u to %u characters", (unsigned)minLength, (unsigned)(size - 1));
+        setFieldError(error, key, problem);
+        return false;
+    }
+    changed |= updateField(field, size, text);
+    return true;
+}
+
+void buildConfigJson(JsonDocument& doc) {
+    // const char* keeps ArduinoJson from copying the strings into the document
+    JsonObject device = doc.createNestedObject("device");
+    device["hostname"] = (const char*)deviceConfig.hostname;
+
+    JsonObject display = doc.createNestedObject("display");
+    display["use_24h_format"] = displayConfig.use_24h_format;
+    display["use_celsius"] = displayConfig.use_celsius;
+    display["date_duration"] = displayConfig.date_duration;
+    display["temp_duration"] = displayConfig.temp_duration;
+    display["humidity_duration"] = displayConfig.humidity_duration;
+    display["auto_brightness"] = displayConfig.auto_brightness;
+    display["min_brightness"] = displayConfig.min_brightness;
+    display["max_brightness"] = displayConfig.max_brightness;
+    display["man_brightness"] = displayConfig.man_brightness;
+    display["temp_delta"] = displayConfig.temp_delta;
+    display["humidity_delta"] = displayConfig.humidity_delta;
+
+    JsonObject time = doc.createNestedObject("time");
+    time["timezone_offset"] = timeConfig.timezone_offset;
+    time["timezone_name"] = (const char*)timeConfig.timezone_name;
+
+    JsonObject mqtt = doc.createNestedObject("mqtt");
+    mqtt["server"] = (const char*)mqttConfig.mqtt_server;
+    mqtt["port"] = mqttConfig.mqtt_port;
+    mqtt["user"] = (const char*)mqttConfig.mqtt_user;
+    mqtt["password_set"] = mqttConfig.mqtt_password[0] != '\0';
+
+    JsonObject firmware = doc.createNestedObject("firmware");
+    firmware["version"] = version;
+    firmware["update_url"] = (const char*)firmwareConfig.update_url;
+    firmware["auto_update"] = firmwareConfig.auto_update;
+
+    JsonObject notify = doc.createNestedObject("notify");
+    notify["url"] = (const char*)notifyConfig.url;
+}
+
+// Copies of everything a document can change, so nothing is applied unless all of it is valid
+struct ConfigDraft {
+    DeviceConfig device;
+    DisplayConfig display;
+    TimeConfig time;
+    MQTTConfig mqtt;
+    SystemCommandConfig system;
+    FirmwareConfig firmware;
+    NotifyConfig notify;
+    uint8_t changed;        // ConfigSection bits
+};
+
+struct SectionName {
+    const char* name;
+    ConfigSection section;
+};
+
+static const SectionName sectionNames[] = {
+    {"device", CONFIG_DEVICE},
+    {"display", CONFIG_DISPLAY},
+    {"time", CONFIG_TIME},
+    {"mqtt", CONFIG_MQTT},
+    {"system", CONFIG_SYSTEM_COMMAND},
+    {"firmware", CONFIG_FIRMWARE},
+    {"notify", CONFIG_NOTIFY}
+};
+
+static void beginDraft(ConfigDraft& draft) {
+    draft.device = deviceConfig;
+    draft.display = displayConfig;
+    draft.time = timeConfig;
+    draft.mqtt = mqttConfig;
+    draft.system = systemCommandConfig;
+    draft.firmware = firmwareConfig;
+    draft.notify = notifyConfig;
+    draft.changed = 0;
+}
+
+// Validates one top-level member into the draft. Names that are not sections are ignored.
+static bool applySection(ConfigDraft& draft, const char* name, JsonVariantConst value, String& error) {
+    const SectionName* known = nullptr;
+    for (const SectionName& s : sectionNames) {
+        if (strcmp(s.name, name) == 0) {
+            known = &s;
+            break;
+        }
+    }
+    if (!known || value.isNull()) {
+        return true;
+    }
+
+    // A section may be omitted, but if present it has to be an object
+    JsonObjectConst section = value.as<JsonObjectConst>();
+    if (section.isNull()) {
+        setFieldError(error, name, "must be an object");
+        return false;
+    }
+
+    bool changed = false;
+    switch (known->section) {
+        case CONFIG_DEVICE:
+            if (!readString(section, "hostname", draft.device.hostname, sizeof(draft.device.hostname), 1, changed, error)) return false;
+            break;
+
+        case CONFIG_DISPLAY: {
+            DisplayConfig& display = draft.display;
+            if (!readBool(section, "use_24h_format", display.use_24h_format, changed, error) ||
+                !readBool(section, "use_celsius", display.use_celsius, changed, error) ||
+                !readNumber(section, "date_duration", 0, 60, display.date_duration, changed, error) ||
+                !readNumber(section, "temp_duration", 0, 60, display.temp_duration, changed, error) ||
+                !readNumber(section, "humidity_duration", 0, 60, display.humidity_duration, changed, error) ||
+                !readBool(section, "auto_brightness", display.auto_brightness, changed, error) ||
+                !readNumber(section, "min_brightness", 0, 15, display.min_brightness, changed, error) ||
+                !readNumber(section, "max_brightness", 0, 15, display.max_brightness, changed, error) ||
+                !readNumber(section, "man_brightness", 0, 15, display.man_brightness, changed, error) ||
+                !readNumber(section, "temp_delta", -10, 10, display.temp_delta, changed, error) ||
+                !readNumber(section, "humidity_delta", -20, 20, display.humidity_delta, changed, error)) {
+                return false;
+            }
+            if (display.min_brightness > display.max_brightness) {
+                error = "min_brightness must not exceed max_brightness";
+                return false;
+            }
+            break;
+        }
+
+        case CONFIG_TIME:
+            if (!readNumber(section, "timezone_offset", -43200, 50400, draft.time.timezone_offset, changed, error) ||
+                !readString(section, "timezone_name", draft.time.timezone_name, sizeof(draft.time.timezone_name), 0, changed, error)) {
+                return false;
+            }
+            break;
+
+        case CONFIG_MQTT:
+            if (!readString(section, "server", draft.mqtt.mqtt_server, sizeof(draft.mqtt.mqtt_server), 0, changed, error) ||
+                !readNumber(section, "port", 0, 65535, draft.mqtt.mqtt_port, changed, error) ||
+                !readString(section, "user", draft.mqtt.mqtt_user, sizeof(draft.mqtt.mqtt_user), 0, changed, error) ||
+                !readString(section, "password", draft.mqtt.mqtt_password, sizeof(draft.mqtt.mqtt_password), 0, changed, error)) {
+                return false;
+            }
+            break;
+
+        case CONFIG_SYSTEM_COMMAND:
+            if (!readString(section, "command", draft.system.command, sizeof(draft.system.command), 0, changed, error)) return false;
+            if (strspn(draft.system.command, "01") != strlen(draft.system.command)) {
+                error = "command must contain only 0s and 1s";
+                return false;
+            }
+            break;
+
+        case CONFIG_FIRMWARE:
+            if (!readString(section, "update_url", draft.firmware.update_url, sizeof(draft.firmware.update_url), 0, changed, error) ||
+                !readBool(section, "auto_update", draft.firmware.auto_update, changed, error)) return false;
+            break;
+
+        case CONFIG_NOTIFY:
+            if (!readString(section, "url", draft.notify.url, sizeof(draft.notify.url), 0, changed, error)) return false;
+            break;
+    }
+
+    if (changed) {
+        draft.changed |= known->section;
+    }
+    return true;
+}
+
+// Swaps every changed section into the live config in one go
+static uint8_t commitDraft(const ConfigDraft& draft) {
+    if (draft.changed & CONFIG_DEVICE) deviceConfig = draft.device;
+    if (draft.changed & CONFIG_DISPLAY) displayConfig = draft.display;
+    if (draft.changed & CONFIG_TIME) timeConfig = draft.time;
+    if (draft.changed & CONFIG_MQTT) mqttConfig = draft.mqtt;
+    if (draft.changed & CONFIG_SYSTEM_COMMAND) systemCommandConfig = draft.system;
+    if (draft.changed & CONFIG_FIRMWARE) firmwareConfig = draft.firmware;
+    if (draft.changed & CONFIG_NOTIFY) notifyConfig = draft.notify;
+    return draft.changed;
+}
+
+bool applyConfigJson(JsonObjectConst root, uint8_t& changedSections, String& error) {
+    changedSections = 0;
+    ConfigDraft draft;
+    beginDraft(draft);
+    for (const SectionName& s : sectionNames) {
+        if (!applySection(draft, s.name, root[s.name], error)) {
+            return false;
+        }
+    }
+    changedSections = commitDraft(draft);
+    return true;
+}
+
+static void sendConfigError(int code, const char* message) {
+    StaticJsonDocument<128> doc;
+    doc["error"] = message;
+    sendJsonResponse(code, doc);
+}
+
+// One flash commit for everything that changed and one restart of each affected service
+static void configApplied(uint8_t changed, const char* source) {
+    if (changed != 0) {
+        markConfigDirty(changed);
+        printBothf("Config updated over %s (sections 0x%02x)", source, changed);
+    }
+    if (changed & CONFIG_MQTT) {
+        deferJob(restartMQTT);
+    }
+    if (changed & CONFIG_TIME) {
+        deferJob(applyTimezone);
+    }
+}
+
+void handleConfigGet() {
+    DynamicJsonDocument doc(1024);
+    buildConfigJson(doc);
+    sendJsonResponse(200, doc);
+}
+
+void handleConfigPatch() {
+    if (!server.hasArg("plain")) {
+        sendConfigError(400, "Missing JSON body");
+        return;
+    }
+
+    DynamicJsonDocument doc(1536);
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+    if (error || !doc.is<JsonObject>()) {
+        sendConfigError(400, "Body must be a JSON object");
+        return;
+    }
+
+    uint8_t changed = 0;
+    String message;
+    if (!applyConfigJson(doc.as<JsonObjectConst>(), changed, message)) {
+        sendConfigError(400, message.c_str());
+        return;
+    }
+
+    configApplied(changed, "API");
+
+    // Reply with the resulting configuration
+    handleConfigGet();
+}
+
+// Bundle import. The body is consumed as it arrives: each top-level member is
+// collected on its own and validated into the draft as soon as it is complete,
+// so memory is bounded by the largest section rather than the whole bundle.
+class ConfigBundleImport {
+public:
+    ConfigBundleImport() : _state(EXPECT_ROOT), _keyLength(0), _valueLength(0), _depth(0),
+                           _inString(false), _escape(false) {
+        beginDraft(_draft);
+    }
+
+    void feed(const char* data, size_t length) {
+        for (size_t i = 0; i < length && _state != FAILED; i++) {
+            feedChar(data[i]);
+        }
+    }
+
+    // True when the bundle was complete and valid, draft() is then ready to commit
+    bool finish(String& error) {
+        if (_state == DONE) {
+            return true;
+        }
+        error = _state == FAILED ? _error : String("Bundle is incomplete");
+        return false;
+    }
+
+    const ConfigDraft& draft() const { return _draft; }
+
+private:
+    enum State : uint8_t {
+        EXPECT_ROOT,
+        EXPECT_KEY,
+        IN_KEY,
+        EXPECT_COLON,
+        EXPECT_VALUE,
+        IN_VALUE,
+        AFTER_VALUE,
+        DONE,
+        FAILED
+    };
+
+    void fail(const char* message) {
+        _error = message;
+        _state = FAILED;
+    }
+
+    void feedChar(char c) {
+        bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        switch (_state) {
+            case EXPECT_ROOT:
+                if (c == '{') _state = EXPECT_KEY;
+                else if (!space) fail("Bundle must be a JSON object");
+                break;
+
+            case EXPECT_KEY:
+                if (c == '"') {
+                    _keyLength = 0;
+                    _escape = false;
+                    _state = IN_KEY;
+                } else if (c == '}') {
+                    _state = DONE;
+                } else if (!space) {
+                    fail("Expected a section name");
+                }
+                break;
+
+            case IN_KEY:
+                // Section names are plain ASCII, an escaped one just won't match
+                if (c == '"' && !_escape) {
+                    _key[_keyLength] = '\0';
+                    _state = EXPECT_COLON;
+                } else {
+                    _escape = c == '\\' && !_escape;
+                    if (_keyLength < sizeof(_key) - 1) _key[_keyLength++] = c;
+                }
+                break;
+
+            case EXPECT_COLON:
+                if (c == ':') _state = EXPECT_VALUE;
+                else if (!space) fail("Expected ':'");
+                break;
+
+            case EXPECT_VALUE:
+                if (space) break;
+                _valueLength = 0;
+                _depth = 0;
+                _inString = false;
+                _escape = false;
+                _state = IN_VALUE;
+                valueChar(c);
+                break;
+
+            case IN_VALUE:
+                valueChar(c);
+                break;
+
+            case AFTER_VALUE:
+                if (c == ',') _state = EXPECT_KEY;
+                else if (c == '}') _state = DONE;
+                else if (!space) fail("Expected ',' or '}'");
+                break;
+
+            case DONE:
+                if (!space) fail("Unexpected data after the bundle");
+                break;
+
+            case FAILED:
+                break;
+        }
+    }
+
+    // Collects one member's value, tracking strings and nesting to find where it ends
+    void valueChar(char c) {
+        if (_inString) {
+            append(c);
+            if (_escape) {
+                _escape = false;
+            } else if (c == '\\') {
+                _escape = true;
+            } else if (c == '"') {
+                _inString = false;
+                if (_depth == 0) endValue();
+            }
+            return;
+        }
+
+        bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        if (_depth == 0 && _valueLength > 0 && (c == ',' || c == '}' || space)) {
+            // End of a bare number, true, false or null
+            endValue();
+            if (_state == AFTER_VALUE && !space) feedChar(c);
+            return;
+        }
+
+        append(c);
+        if (c == '"') {
+            _inString = true;
+        } else if (c == '{' || c == '[') {
+            _depth++;
+        } else if (c == '}' || c == ']') {
+            if (_depth == 0) {
+                fail("Unbalanced brackets");
+                return;
+            }
+            if (--_depth == 0) endValue();
+        }
+    }
+
+    void append(char c) {
+        if (_valueLength >= sizeof(_value) - 1) {
+            char message[48];
+            snprintf(message, sizeof(message), "%s is too large", _key);
+            fail(message);
+            return;
+        }
+        _value[_valueLength++] = c;
+    }
+
+    void endValue() {
+        if (_state == FAILED) {
+            return;
+        }
+        _state = AFTER_VALUE;
+        _value[_valueLength] = '\0';
+
+        // Parsed in place, the document points into _value
+        StaticJsonDocument<JSON_OBJECT_SIZE(16)> doc;
+        DeserializationError error = deserializeJson(doc, _value, _valueLength);
+        if (error) {
+            char message[64];
+            snprintf(message, sizeof(message), "%s is not valid JSON: %s", _key, error.c_str());
+            fail(message);
+            return;
+        }
+        String problem;
+        if (!applySection(_draft, _key, doc.as<JsonVariantConst>(), problem)) {
+            fail(problem.c_str());
+        }
+    }
+
+    ConfigDraft _draft;
+    State _state;
+    char _key[16];
+    uint8_t _keyLength;
+    char _value[CONFIG_BUNDLE_VALUE_MAX];
+    size_t _valueLength;
+    uint8_t _depth;
+    bool _inString;
+    bool _escape;
+    String _error;
+};
+
+// One import at a time: a new upload replaces one that was abandoned
+static ConfigBundleImport* bundleImport = nullptr;
+
+static void discardBundleImport() {
+    delete bundleImport;
+    bundleImport = nullptr;
+}
+
+void buildConfigBundle(JsonDocument& doc) {
+    buildConfigJson(doc);
+    // Unlike GET /api/config the bundle carries everything a new clock needs
+    doc["mqtt"]["password"] = (const char*)mqttConfig.mqtt_password;
+    doc["system"]["command"] = (const char*)systemCommandConfig.command;
+}
+
+void handleConfigBundleExport() {
+    DynamicJsonDocument doc(1536);
+    buildConfigBundle(doc);
+
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"%s-config.json\"", deviceConfig.hostname);
+    server.sendHeader("Content-Disposition", disposition);
+    sendJsonResponse(200, doc);
+}
+
+void handleConfigBundleUpload() {
+    HTTPUpload& upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+        discardBundleImport();
+        bundleImport = new ConfigBundleImport();
+    } else if (upload.status == UPLOAD_FILE_WRITE && bundleImport) {
+        bundleImport->feed((const char*)upload.buf, upload.currentSize);
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+        discardBundleImport();
+    }
+}
+
+void handleConfigBundleImport() {
+    // A plain JSON body arrives whole, an uploaded file has already been fed in
+    if (!bundleImport) {
+        if (!server.hasArg("plain")) {
+            sendConfigError(400, "Missing bundle");
+            return;
+        }
+        bundleImport = new ConfigBundleImport();
+        String body = server.arg("plain");
+        bundleImport->feed(body.c_str(), body.length());
+    }
+
+    String message;
+    if (!bundleImport->finish(message)) {
+        discardBundleImport();
+        sendConfigError(400, message.c_str());
+        return;
+    }
+
+    uint8_t changed = commitDraft(bundleImport->draft());
+    discardBundleImport();
+    configApplied(changed, "bundle import");
+
+    // Reply with the resulting configuration
+    handleConfigGet();
+}
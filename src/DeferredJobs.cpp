@@ -0,0 +1,50 @@
+#include "DeferredJobs.h"
+#include "WiFiSetup.h"
+
+struct PendingJob {
+    DeferredJob job;
+    uint32_t queuedAt;
+    uint32_t delayMs;
+};
+
+uint32_t deferredJobsRun = 0;
+uint32_t deferredJobsDropped = 0;
+
+static PendingJob pendingJobs[DEFERRED_MAX_JOBS];
+static uint8_t pendingJobCount = 0;
+
+bool deferJob(DeferredJob job, uint32_t delayMs) {
+    for (uint8_t i = 0; i < pendingJobCount; i++) {
+        if (pendingJobs[i].job == job) {
+            return true;
+        }
+    }
+    if (pendingJobCount == DEFERRED_MAX_JOBS) {
+        deferredJobsDropped++;
+        printBoth("Deferred job queue full - job dropped");
+        return false;
+    }
+
+    PendingJob& pending = pendingJobs[pendingJobCount++];
+    pending.job = job;
+    pending.queuedAt = millis();
+    pending.delayMs = delayMs;
+    return true;
+}
+
+void runDeferredJobs() {
+    uint8_t i = 0;
+    while (i < pendingJobCount) {
+        PendingJob pending = pendingJobs[i];
+        if (millis() - pending.queuedAt < pending.delayMs) {
+            i++;
+            continue;
+        }
+
+        // Take it off the queue first, the job may queue more work
+        pendingJobCount--;
+        memmove(&pendingJobs[i], &pendingJobs[i + 1], (pendingJobCount - i) * sizeof(PendingJob));
+        deferredJobsRun++;
+        pending.job();
+    }
+}
@@ -0,0 +1,192 @@
+#include "DeltaPatch.h"
+#include <Updater.h>
+
+#define DELTA_COPY 1
+#define DELTA_INSERT 2
+
+static uint32_t readLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DeltaPatch::DeltaPatch() : _state(HEADER), _error(nullptr), _headerLength(0), _oldSize(0), _newSize(0),
+                           _varint(0), _varintShift(0), _copyDelta(0), _copyOffset(0), _copyEnd(0),
+                           _remaining(0), _written(0) {}
+
+void DeltaPatch::fail(const char* message) {
+    _error = message;
+    _state = FAILED;
+}
+
+bool DeltaPatch::busy() const {
+    return _state == VERIFY_BASE || _state == COPYING;
+}
+
+// LEB128, true once the last byte is in
+bool DeltaPatch::readVarint(uint8_t byte) {
+    if (_varintShift > 28) {
+        fail("bad varint");
+        return false;
+    }
+    _varint |= (uint32_t)(byte & 0x7F) << _varintShift;
+    _varintShift += 7;
+    return (byte & 0x80) == 0;
+}
+
+bool DeltaPatch::output(const uint8_t* data, size_t length) {
+    if (length > _newSize - _written) {
+        fail("patch runs past the image");
+        return false;
+    }
+    if (Update.write(const_cast<uint8_t*>(data), length) != length) {
+        fail("flash write");
+        return false;
+    }
+    br_sha256_update(&_hash, data, length);
+    _written += length;
+    return true;
+}
+
+// After each operation: either the image is complete and must hash right, or another one follows
+void DeltaPatch::nextOp() {
+    if (_written < _newSize) {
+        _state = OP;
+        return;
+    }
+    uint8_t digest[32];
+    br_sha256_out(&_hash, digest);
+    if (memcmp(digest, _header + 44, sizeof(digest)) != 0) {
+        fail("image hash mismatch");
+        return;
+    }
+    _state = COMPLETE;
+}
+
+void DeltaPatch::step() {
+    if (_state == VERIFY_BASE) {
+        size_t length = _remaining < sizeof(_chunk) ? _remaining : sizeof(_chunk);
+        if (!ESP.flashRead(_oldSize - _remaining, _chunk, length)) {
+            fail("flash read");
+            return;
+        }
+        br_sha256_update(&_hash, _chunk, length);
+        _remaining -= length;
+        if (_remaining == 0) {
+            uint8_t digest[32];
+            br_sha256_out(&_hash, digest);
+            if (memcmp(digest, _header + 8, sizeof(digest)) != 0) {
+                fail("running firmware is not the delta base");
+                return;
+            }
+            // The same context now hashes the image being built
+            br_sha256_init(&_hash);
+            nextOp();
+        }
+    } else if (_state == COPYING) {
+        size_t length = _remaining < sizeof(_chunk) ? _remaining : sizeof(_chunk);
+        if (!ESP.flashRead(_copyOffset, _chunk, length)) {
+            fail("flash read");
+            return;
+        }
+        if (!output(_chunk, length)) {
+            return;
+        }
+        _copyOffset += length;
+        _remaining -= length;
+        if (_remaining == 0) {
+            nextOp();
+        }
+    }
+}
+
+size_t DeltaPatch::feed(const uint8_t* data, size_t length) {
+    size_t used = 0;
+    while (used < length && !busy() && _state != COMPLETE && _state != FAILED) {
+        uint8_t byte = data[used];
+        switch (_state) {
+            case HEADER:
+                _header[_headerLength++] = byte;
+                used++;
+                if (_headerLength == DELTA_HEADER_SIZE) {
+                    if (memcmp(_header, "DCP1", 4) != 0) {
+                        fail("not a delta image");
+                        break;
+                    }
+                    _oldSize = readLE32(_header + 4);
+                    _newSize = readLE32(_header + 40);
+                    if (_oldSize == 0 || _newSize == 0) {
+                        fail("bad delta header");
+                        break;
+                    }
+                    br_sha256_init(&_hash);
+                    _remaining = _oldSize;
+                    _state = VERIFY_BASE;
+                }
+                break;
+
+            case OP:
+                used++;
+                _varint = 0;
+                _varintShift = 0;
+                if (byte == DELTA_COPY) _state = COPY_OFFSET;
+                else if (byte == DELTA_INSERT) _state = INSERT_LENGTH;
+                else fail("bad delta operation");
+                break;
+
+            case COPY_OFFSET:
+                used++;
+                if (readVarint(byte)) {
+                    // Zigzag: even is forward, odd is backward
+                    _copyDelta = (_varint & 1) ? -(int32_t)((_varint + 1) >> 1) : (int32_t)(_varint >> 1);
+                    _varint = 0;
+                    _varintShift = 0;
+                    _state = COPY_LENGTH;
+                }
+                break;
+
+            case COPY_LENGTH:
+                used++;
+                if (readVarint(byte)) {
+                    _copyOffset = _copyEnd + _copyDelta;
+                    if (_varint == 0 || _copyOffset > _oldSize || _varint > _oldSize - _copyOffset) {
+                        fail("copy outside the base image");
+                        break;
+                    }
+                    _remaining = _varint;
+                    _copyEnd = _copyOffset + _varint;
+                    _state = COPYING;
+                }
+                break;
+
+            case INSERT_LENGTH:
+                used++;
+                if (readVarint(byte)) {
+                    if (_varint == 0) {
+                        fail("empty insert");
+                        break;
+                    }
+                    _remaining = _varint;
+                    _state = INSERTING;
+                }
+                break;
+
+            case INSERTING: {
+                // Straight from the caller's buffer into flash
+                size_t take = length - used;
+                if (take > _remaining) take = _remaining;
+                if (!output(data + used, take)) {
+                    break;
+                }
+                used += take;
+                _remaining -= take;
+                if (_remaining == 0) {
+                    nextOp();
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+    return used;
+}
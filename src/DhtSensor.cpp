@@ -0,0 +1,136 @@
+#include "DhtSensor.h"
+#include <Ticker.h>
+
+enum DhtState : uint8_t {
+    DHT_STATE_IDLE,
+    DHT_STATE_START,        // Line held low, the ticker releases it
+    DHT_STATE_CAPTURING
+};
+
+uint32_t dhtChecksumFailures = 0;
+uint32_t dhtTimeouts = 0;
+uint32_t dhtResponseUs = 0;
+uint32_t dhtCpuUs = 0;
+uint8_t dhtZeroHighMaxUs = 0;
+uint8_t dhtOneHighMinUs = 0;
+
+static uint8_t dhtPin = 0;
+static volatile DhtState dhtState = DHT_STATE_IDLE;
+static unsigned long dhtStartMs = 0;
+static Ticker dhtReleaseTicker;
+static float dhtLastTemperature = NAN;
+static float dhtLastHumidity = NAN;
+
+// Written by the edge interrupt: microseconds since the previous edge, capped at 255
+static volatile uint8_t dhtEdgeCount = 0;
+static volatile uint32_t dhtLastEdgeUs = 0;
+static uint32_t dhtReleasedUs = 0;
+static uint8_t dhtEdges[DHT_MAX_EDGES];
+
+static void IRAM_ATTR dhtEdge() {
+    uint32_t now = micros();
+    uint8_t count = dhtEdgeCount;
+    if (count < DHT_MAX_EDGES) {
+        uint32_t width = now - dhtLastEdgeUs;
+        dhtEdges[count] = width > 255 ? 255 : width;
+        dhtEdgeCount = count + 1;
+    }
+    dhtLastEdgeUs = now;
+}
+
+// Ends the start signal, from the ticker's timer context
+static void dhtRelease() {
+    dhtEdgeCount = 0;
+    dhtReleasedUs = micros();
+    dhtLastEdgeUs = dhtReleasedUs;
+    pinMode(dhtPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(dhtPin), dhtEdge, CHANGE);
+    dhtState = DHT_STATE_CAPTURING;
+}
+
+void dhtBegin(uint8_t pin) {
+    dhtPin = pin;
+    pinMode(dhtPin, INPUT_PULLUP);
+}
+
+bool dhtStart() {
+    if (dhtState != DHT_STATE_IDLE) {
+        return false;
+    }
+    uint32_t start = micros();
+    dhtState = DHT_STATE_START;
+    dhtStartMs = millis();
+    pinMode(dhtPin, OUTPUT);
+    digitalWrite(dhtPin, LOW);
+    dhtReleaseTicker.once_ms(DHT_START_LOW_MS, dhtRelease);
+    dhtCpuUs = micros() - start;
+    return true;
+}
+
+// Edges: 0 the sensor pulling low, 1 and 2 its 80 us low and high, then per bit
+// a rising edge after 50 us low and a falling one whose width is the bit
+static DhtStatus dhtDecode() {
+    uint8_t data[5] = {0};
+    uint8_t zeroMax = 0;
+    uint8_t oneMin = 255;
+    for (uint8_t bit = 0; bit < 40; bit++) {
+        uint8_t high = dhtEdges[4 + bit * 2];
+        data[bit / 8] <<= 1;
+        if (high > DHT_ONE_THRESHOLD_US) {
+            data[bit / 8] |= 1;
+            if (high < oneMin) oneMin = high;
+        } else if (high > zeroMax) {
+            zeroMax = high;
+        }
+    }
+
+    if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4]) {
+        dhtChecksumFailures++;
+        return DHT_CHECKSUM_ERROR;
+    }
+    dhtZeroHighMaxUs = zeroMax;
+    dhtOneHighMinUs = oneMin;
+    dhtLastHumidity = ((data[0] << 8) | data[1]) * 0.1f;
+    dhtLastTemperature = (((data[2] & 0x7F) << 8) | data[3]) * 0.1f;
+    if (data[2] & 0x80) {
+        dhtLastTemperature = -dhtLastTemperature;
+    }
+    return DHT_OK;
+}
+
+DhtStatus dhtPoll() {
+    if (dhtState == DHT_STATE_IDLE) {
+        return DHT_IDLE;
+    }
+    bool complete = dhtState == DHT_STATE_CAPTURING && dhtEdgeCount >= DHT_RESPONSE_EDGES;
+    if (!complete && millis() - dhtStartMs < DHT_RESPONSE_TIMEOUT_MS) {
+        return DHT_BUSY;
+    }
+
+    uint32_t start = micros();
+    dhtReleaseTicker.detach();
+    if (dhtState == DHT_STATE_CAPTURING) {
+        detachInterrupt(digitalPinToInterrupt(dhtPin));
+    }
+    dhtState = DHT_STATE_IDLE;
+    pinMode(dhtPin, INPUT_PULLUP);
+
+    DhtStatus status;
+    if (complete) {
+        dhtResponseUs = dhtLastEdgeUs - dhtReleasedUs;
+        status = dhtDecode();
+    } else {
+        dhtTimeouts++;
+        status = DHT_TIMEOUT;
+    }
+    dhtCpuUs += micros() - start;
+    return status;
+}
+
+float dhtTemperature() {
+    return dhtLastTemperature;
+}
+
+float dhtHumidity() {
+    return dhtLastHumidity;
+}
@@ -0,0 +1,35 @@
+#include "HeapStats.h"
+#include "WiFiSetup.h"
+
+static uint32_t heapLowWater = UINT32_MAX;
+
+void sampleHeap() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < heapLowWater) {
+        heapLowWater = freeHeap;
+    }
+}
+
+uint32_t getHeapLowWater() {
+    sampleHeap();
+    return heapLowWater;
+}
+
+void resetHeapLowWater() {
+    heapLowWater = UINT32_MAX;
+    sampleHeap();
+}
+
+void handleHeapStats() {
+    StaticJsonDocument<128> doc;
+    doc["free"] = ESP.getFreeHeap();
+    doc["low_water"] = getHeapLowWater();
+    doc["max_block"] = ESP.getMaxFreeBlockSize();
+    doc["fragmentation"] = ESP.getHeapFragmentation();
+    sendJsonResponse(200, doc);
+
+    // Reset after answering so the window starts clean of this request
+    if (server.hasArg("reset")) {
+        resetHeapLowWater();
+    }
+}
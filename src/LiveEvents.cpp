@@ -0,0 +1,203 @@
+#include "LiveEvents.h"
+#include "WiFiSetup.h"
+
+// The event-driven server hands out stream handles, ESP8266WebServer the client itself
+#ifdef ASYNC_HTTP_SERVER
+typedef uint16_t LiveClient;
+#else
+typedef WiFiClient LiveClient;
+#endif
+
+struct Subscriber {
+    bool active;
+    LiveClient client;
+    unsigned long lastWrite;
+};
+
+static Subscriber subscribers[LIVE_MAX_SUBSCRIBERS];
+
+// Last values pushed, so unchanged ones are never resent
+static float lastTemperature = NAN;
+static float lastHumidity = NAN;
+static int lastIntensity = -100;
+static uint8_t lastDisplayItem = 0;
+static char lastTimeText[12] = "";
+
+static const char* displayItemName(uint8_t item) {
+    switch (item) {
+        case 1: return "date";
+        case 2: return "temperature";
+        case 3: return "humidity";
+        default: return "";
+    }
+}
+
+// Never blocks: a subscriber that cannot take the whole event right now is dropped
+static bool subscriberWrite(Subscriber& s, const char* data, size_t length) {
+#ifdef ASYNC_HTTP_SERVER
+    return server.streamWrite(s.client, data, length);
+#else
+    if (!s.client.connected() || s.client.availableForWrite() < (int)length) {
+        return false;
+    }
+    return s.client.write((const uint8_t*)data, length) == length;
+#endif
+}
+
+static bool subscriberConnected(Subscriber& s) {
+#ifdef ASYNC_HTTP_SERVER
+    return server.streamConnected(s.client);
+#else
+    return s.client.connected();
+#endif
+}
+
+static void dropSubscriber(Subscriber& s) {
+#ifdef ASYNC_HTTP_SERVER
+    server.streamClose(s.client);
+#else
+    s.client.stop();
+#endif
+    s.active = false;
+}
+
+static void broadcast(const char* json) {
+    char event[112];
+    int length = snprintf(event, sizeof(event), "data: %s\n\n", json);
+    if (length <= 0 || length >= (int)sizeof(event)) {
+        return;
+    }
+    for (Subscriber& s : subscribers) {
+        if (!s.active) {
+            continue;
+        }
+        if (subscriberWrite(s, event, length)) {
+            s.lastWrite = millis();
+        } else {
+            dropSubscriber(s);
+        }
+    }
+}
+
+uint8_t getLiveSubscriberCount() {
+    uint8_t count = 0;
+    for (const Subscriber& s : subscribers) {
+        if (s.active) count++;
+    }
+    return count;
+}
+
+void handleLiveSubscribe() {
+    Subscriber* slot = nullptr;
+    for (Subscriber& s : subscribers) {
+        if (!s.active) {
+            slot = &s;
+            break;
+        }
+    }
+    if (!slot) {
+        server.send(503, "text/plain", "Too many live subscribers");
+        return;
+    }
+
+    // Headers go out raw, the connection then stays open for the events
+    server.client().print(F("HTTP/1.1 200 OK\r\n"
+                            "Content-Type: text/event-stream\r\n"
+                            "Cache-Control: no-cache\r\n"
+                            "Connection: keep-alive\r\n\r\n"));
+#ifdef ASYNC_HTTP_SERVER
+    slot->client = server.detachStream();
+    if (!slot->client) {
+        return;
+    }
+#else
+    slot->client = server.client();
+    slot->client.setNoDelay(true);
+#endif
+    slot->active = true;
+
+    // Start the new subscriber off with everything known so far
+    char snapshot[160];
+    int length = snprintf(snapshot, sizeof(snapshot), "retry: 5000\ndata: {\"intensity\":%d,\"display\":\"%s\",\"time\":\"%s\"",
+                          lastIntensity, displayItemName(lastDisplayItem), lastTimeText);
+    if (!isnan(lastTemperature)) {
+        length += snprintf(snapshot + length, sizeof(snapshot) - length, ",\"temperature\":%.1f,\"humidity\":%.1f",
+                           lastTemperature, lastHumidity);
+    }
+    length += snprintf(snapshot + length, sizeof(snapshot) - length, "}\n\n");
+
+    if (subscriberWrite(*slot, snapshot, length)) {
+        slot->lastWrite = millis();
+        printBothf("Live subscriber connected (%u of %u)", getLiveSubscriberCount(), LIVE_MAX_SUBSCRIBERS);
+    } else {
+        dropSubscriber(*slot);
+    }
+}
+
+void handleLiveEvents() {
+    unsigned long now = millis();
+    for (Subscriber& s : subscribers) {
+        if (!s.active) {
+            continue;
+        }
+        if (!subscriberConnected(s)) {
+            dropSubscriber(s);
+            continue;
+        }
+        if (now - s.lastWrite >= LIVE_KEEPALIVE_MS) {
+            if (subscriberWrite(s, ":\n\n", 3)) {
+                s.lastWrite = now;
+            } else {
+                dropSubscriber(s);
+            }
+        }
+    }
+}
+
+void liveUpdateReading(float temperature, float humidity) {
+    // Compare at the resolution that is shown
+    float temperatureShown = roundf(temperature * 10) / 10;
+    float humidityShown = roundf(humidity * 10) / 10;
+    if (temperatureShown == lastTemperature && humidityShown == lastHumidity) {
+        return;
+    }
+    lastTemperature = temperatureShown;
+    lastHumidity = humidityShown;
+
+    char json[64];
+    snprintf(json, sizeof(json), "{\"temperature\":%.1f,\"humidity\":%.1f}", lastTemperature, lastHumidity);
+    broadcast(json);
+}
+
+void liveUpdateIntensity(int intensity) {
+    if (intensity == lastIntensity) {
+        return;
+    }
+    lastIntensity = intensity;
+
+    char json[24];
+    snprintf(json, sizeof(json), "{\"intensity\":%d}", intensity);
+    broadcast(json);
+}
+
+void liveUpdateDisplayItem(uint8_t item) {
+    if (item == lastDisplayItem) {
+        return;
+    }
+    lastDisplayItem = item;
+
+    char json[32];
+    snprintf(json, sizeof(json), "{\"display\":\"%s\"}", displayItemName(item));
+    broadcast(json);
+}
+
+void liveUpdateTime(const char* timeText) {
+    if (strcmp(timeText, lastTimeText) == 0) {
+        return;
+    }
+    strlcpy(lastTimeText, timeText, sizeof(lastTimeText));
+
+    char json[32];
+    snprintf(json, sizeof(json), "{\"time\":\"%s\"}", lastTimeText);
+    broadcast(json);
+}
@@ -0,0 +1,268 @@
+#include "Metrics.h"
+#include "WiFiSetup.h"
+#include "TimeSync.h"
+#include "HeapStats.h"
+#include "DeferredJobs.h"
+#include "DhtSensor.h"
+
+struct RouteCounter {
+    const char* uri;
+    HTTPMethod method;
+    uint32_t count;
+    uint64_t timeUs;        // Spent in the handler, not counting a body sent after it returns
+};
+
+static RouteCounter routeCounters[METRICS_MAX_ROUTES];
+static uint8_t routeCounterCount = 0;
+
+static bool loopStarted = false;
+static uint32_t lastLoopStart = 0;
+static uint64_t loopTimeTotalUs = 0;
+static uint32_t loopCount = 0;
+static uint32_t loopTimeMaxUs = 0;          // Since the last scrape
+
+static uint32_t dhtReads = 0;
+static uint32_t dhtFailures = 0;
+static uint64_t dhtTimeTotalUs = 0;
+static uint32_t dhtLastDurationUs = 0;
+
+static WiFiEventHandler wifiGotIpHandler;
+static bool wifiConnectedOnce = false;
+static uint32_t wifiReconnects = 0;
+
+// Prometheus text format written through one fixed buffer and sent as chunks.
+// Names and help texts stay in flash.
+class MetricsWriter {
+public:
+    MetricsWriter() : _len(0), _name(nullptr) {}
+
+    // Starts a metric family, the samples that follow use its name
+    void family(PGM_P name, PGM_P type, PGM_P help) {
+        _name = name;
+        reserve(strlen_P(name) * 2 + strlen_P(type) + strlen_P(help) + 16);
+        append("# HELP ");
+        appendP(name);
+        append(" ");
+        appendP(help);
+        append("\n# TYPE ");
+        appendP(name);
+        append(" ");
+        appendP(type);
+        append("\n");
+    }
+
+    // labels is the inside of {...} or nullptr, suffix is appended to the name (_sum, _count)
+    void sample(const char* labels, double value, uint8_t decimals = 0, const char* suffix = nullptr) {
+        char text[24];
+        snprintf(text, sizeof(text), "%.*f", decimals, value);
+        reserve(strlen_P(_name) + (suffix ? strlen(suffix) : 0) + (labels ? strlen(labels) + 2 : 0) + strlen(text) + 2);
+        appendP(_name);
+        if (suffix) {
+            append(suffix);
+        }
+        if (labels) {
+            append("{");
+            append(labels);
+            append("}");
+        }
+        append(" ");
+        append(text);
+        append("\n");
+    }
+
+    void finish() {
+        flush();
+        server.sendContent("");
+    }
+
+private:
+    void reserve(size_t length) {
+        if (_len + length > sizeof(_buf)) {
+            flush();
+        }
+    }
+
+    void append(const char* text) {
+        size_t length = strlen(text);
+        if (length > sizeof(_buf) - _len) length = sizeof(_buf) - _len;
+        memcpy(_buf + _len, text, length);
+        _len += length;
+    }
+
+    void appendP(PGM_P text) {
+        size_t length = strlen_P(text);
+        if (length > sizeof(_buf) - _len) length = sizeof(_buf) - _len;
+        memcpy_P(_buf + _len, text, length);
+        _len += length;
+    }
+
+    void flush() {
+        if (_len > 0) {
+            server.sendContent(_buf, _len);
+            _len = 0;
+        }
+    }
+
+    char _buf[METRICS_BUFFER_SIZE];
+    size_t _len;
+    PGM_P _name;
+};
+
+static const char* methodName(HTTPMethod method) {
+    switch (method) {
+        case HTTP_GET: return "GET";
+        case HTTP_HEAD: return "HEAD";
+        case HTTP_POST: return "POST";
+        case HTTP_PUT: return "PUT";
+        case HTTP_PATCH: return "PATCH";
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_OPTIONS: return "OPTIONS";
+        default: return "ANY";
+    }
+}
+
+void setupMetrics() {
+    // Every connection after the first one since boot is a reconnect
+    wifiGotIpHandler = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP&) {
+        if (wifiConnectedOnce) {
+            wifiReconnects++;
+        }
+        wifiConnectedOnce = true;
+    });
+}
+
+void recordLoopPass() {
+    uint32_t now = micros();
+    if (loopStarted) {
+        uint32_t elapsed = now - lastLoopStart;
+        loopTimeTotalUs += elapsed;
+        loopCount++;
+        if (elapsed > loopTimeMaxUs) {
+            loopTimeMaxUs = elapsed;
+        }
+    }
+    lastLoopStart = now;
+    loopStarted = true;
+}
+
+void recordDhtRead(bool ok, uint32_t durationUs) {
+    dhtReads++;
+    if (!ok) {
+        dhtFailures++;
+    }
+    dhtTimeTotalUs += durationUs;
+    dhtLastDurationUs = durationUs;
+}
+
+std::function<void(void)> countRequests(const char* uri, HTTPMethod method, std::function<void(void)> handler) {
+    if (routeCounterCount == METRICS_MAX_ROUTES) {
+        return handler;
+    }
+    RouteCounter* counter = &routeCounters[routeCounterCount++];
+    counter->uri = uri;
+    counter->method = method;
+    counter->count = 0;
+    counter->timeUs = 0;
+    return [counter, handler]() {
+        uint32_t start = micros();
+        counter->count++;
+        handler();
+        counter->timeUs += micros() - start;
+    };
+}
+
+void handleMetrics() {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain; version=0.0.4", "");
+    MetricsWriter out;
+
+    out.family(PSTR("deskclock_uptime_seconds"), PSTR("gauge"), PSTR("Seconds since boot"));
+    out.sample(nullptr, micros64() / 1e6, 3);
+    out.family(PSTR("deskclock_info"), PSTR("gauge"), PSTR("Firmware version"));
+    char labels[64];
+    snprintf(labels, sizeof(labels), "version=\"%.2f\"", version);
+    out.sample(labels, 1);
+
+    out.family(PSTR("deskclock_heap_free_bytes"), PSTR("gauge"), PSTR("Free heap"));
+    out.sample(nullptr, ESP.getFreeHeap());
+    out.family(PSTR("deskclock_heap_low_water_bytes"), PSTR("gauge"), PSTR("Smallest free heap seen since boot or the last /api/heap reset"));
+    out.sample(nullptr, getHeapLowWater());
+    out.family(PSTR("deskclock_heap_max_block_bytes"), PSTR("gauge"), PSTR("Largest free heap block"));
+    out.sample(nullptr, ESP.getMaxFreeBlockSize());
+    out.family(PSTR("deskclock_heap_fragmentation_percent"), PSTR("gauge"), PSTR("Heap fragmentation"));
+    out.sample(nullptr, ESP.getHeapFragmentation());
+
+    out.family(PSTR("deskclock_loop_latency_seconds"), PSTR("summary"), PSTR("Time between main loop passes"));
+    out.sample(nullptr, loopTimeTotalUs / 1e6, 6, "_sum");
+    out.sample(nullptr, loopCount, 0, "_count");
+    out.family(PSTR("deskclock_loop_latency_max_seconds"), PSTR("gauge"), PSTR("Longest main loop pass since the last scrape"));
+    out.sample(nullptr, loopTimeMaxUs / 1e6, 6);
+    loopTimeMaxUs = 0;
+
+    out.family(PSTR("deskclock_dht_reads_total"), PSTR("counter"), PSTR("DHT sensor reads"));
+    out.sample(nullptr, dhtReads);
+    out.family(PSTR("deskclock_dht_read_failures_total"), PSTR("counter"), PSTR("DHT sensor reads that returned no valid value"));
+    out.sample(nullptr, dhtFailures);
+    out.family(PSTR("deskclock_dht_checksum_failures_total"), PSTR("counter"), PSTR("DHT responses with a bad checksum"));
+    out.sample(nullptr, dhtChecksumFailures);
+    out.family(PSTR("deskclock_dht_timeouts_total"), PSTR("counter"), PSTR("DHT conversions without a complete response"));
+    out.sample(nullptr, dhtTimeouts);
+    out.family(PSTR("deskclock_dht_read_duration_seconds"), PSTR("summary"), PSTR("Main loop time spent starting and decoding DHT sensor reads"));
+    out.sample(nullptr, dhtTimeTotalUs / 1e6, 6, "_sum");
+    out.sample(nullptr, dhtReads, 0, "_count");
+    out.family(PSTR("deskclock_dht_last_read_duration_seconds"), PSTR("gauge"), PSTR("Main loop time of the latest DHT sensor read"));
+    out.sample(nullptr, dhtLastDurationUs / 1e6, 6);
+    out.family(PSTR("deskclock_dht_response_seconds"), PSTR("gauge"), PSTR("Latest DHT response, start signal released to the last bit"));
+    out.sample(nullptr, dhtResponseUs / 1e6, 6);
+    out.family(PSTR("deskclock_dht_bit_high_seconds"), PSTR("gauge"), PSTR("Longest 0 and shortest 1 bit of the latest good DHT read"));
+    out.sample("bit=\"0\"", dhtZeroHighMaxUs / 1e6, 6);
+    out.sample("bit=\"1\"", dhtOneHighMinUs / 1e6, 6);
+
+    out.family(PSTR("deskclock_mqtt_publishes_total"), PSTR("counter"), PSTR("MQTT messages published"));
+    out.sample(nullptr, mqttPublishes);
+    out.family(PSTR("deskclock_mqtt_reconnects_total"), PSTR("counter"), PSTR("Successful MQTT broker connections"));
+    out.sample(nullptr, mqttReconnects);
+    out.family(PSTR("deskclock_mqtt_failures_total"), PSTR("counter"), PSTR("Failed MQTT connection attempts and publishes"));
+    out.sample(nullptr, mqttFailures);
+    out.family(PSTR("deskclock_mqtt_connected"), PSTR("gauge"), PSTR("1 while connected to the MQTT broker"));
+    out.sample(nullptr, mqttClient.connected() ? 1 : 0);
+
+    out.family(PSTR("deskclock_wifi_rssi_dbm"), PSTR("gauge"), PSTR("WiFi signal strength"));
+    out.sample(nullptr, WiFi.RSSI());
+    out.family(PSTR("deskclock_wifi_reconnects_total"), PSTR("counter"), PSTR("WiFi connections after the first since boot"));
+    out.sample(nullptr, wifiReconnects);
+
+    out.family(PSTR("deskclock_display_intensity"), PSTR("gauge"), PSTR("Current display intensity, 0 to 15"));
+    out.sample(nullptr, getDisplayIntensity());
+
+    out.family(PSTR("deskclock_ntp_syncs_total"), PSTR("counter"), PSTR("SNTP syncs since boot"));
+    out.sample(nullptr, getTimeSyncCount());
+    const TimeSyncEvent* sync = getTimeSyncEvent(0);
+    if (sync) {
+        out.family(PSTR("deskclock_ntp_last_sync_timestamp_seconds"), PSTR("gauge"), PSTR("Unix time of the latest SNTP sync"));
+        out.sample(nullptr, sync->time);
+        out.family(PSTR("deskclock_ntp_last_offset_seconds"), PSTR("gauge"), PSTR("Error corrected by the latest SNTP sync"));
+        out.sample(nullptr, sync->offset_ms / 1000.0, 3);
+    }
+    out.family(PSTR("deskclock_ntp_drift_ppm"), PSTR("gauge"), PSTR("Estimated clock drift"));
+    out.sample(nullptr, getClockDriftPpm(), 2);
+
+    out.family(PSTR("deskclock_http_requests_total"), PSTR("counter"), PSTR("HTTP requests handled per route"));
+    for (uint8_t i = 0; i < routeCounterCount; i++) {
+        snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", routeCounters[i].uri, methodName(routeCounters[i].method));
+        out.sample(labels, routeCounters[i].count);
+    }
+    out.family(PSTR("deskclock_http_handler_seconds"), PSTR("summary"), PSTR("Time spent in route handlers before they return"));
+    for (uint8_t i = 0; i < routeCounterCount; i++) {
+        snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", routeCounters[i].uri, methodName(routeCounters[i].method));
+        out.sample(labels, routeCounters[i].timeUs / 1e6, 6, "_sum");
+        out.sample(labels, routeCounters[i].count, 0, "_count");
+    }
+
+    out.family(PSTR("deskclock_deferred_jobs_total"), PSTR("counter"), PSTR("Side effects run from loop() after their HTTP response"));
+    out.sample(nullptr, deferredJobsRun);
+    out.family(PSTR("deskclock_deferred_jobs_dropped_total"), PSTR("counter"), PSTR("Deferred jobs dropped because the queue was full"));
+    out.sample(nullptr, deferredJobsDropped);
+
+    out.finish();
+}
@@ -0,0 +1,219 @@
+#include "MqttOta.h"
+#include "OtaUpdate.h"
+#include "WiFiSetup.h"
+#include "DeferredJobs.h"
+#include <bearssl/bearssl_hash.h>
+
+enum MqttOtaState : uint8_t {
+    MQTT_OTA_IDLE,
+    MQTT_OTA_RECEIVING,
+    MQTT_OTA_DONE,
+    MQTT_OTA_FAILED
+};
+
+static MqttOtaState otaState = MQTT_OTA_IDLE;
+static uint32_t otaSize = 0;
+static uint32_t otaReceived = 0;
+static uint32_t otaNextSeq = 0;
+static uint8_t otaSha256[32];
+static br_sha256_context otaHash;
+static unsigned long otaLastChunk = 0;
+static bool otaAckPending = false;          // Acks go out from loop(), publishing would overwrite the payload
+static bool otaGapReported = false;         // One ack per gap, not one per chunk past it
+static const char* otaError = nullptr;
+static uint16_t otaDefaultBufferSize = 0;   // Restored once the update is over
+
+static size_t otaTopic(const char* name, char* out, size_t size) {
+    return snprintf(out, size, "homeassistant/%s/ota/%s", deviceConfig.hostname, name);
+}
+
+static const char* otaStateName() {
+    switch (otaState) {
+        case MQTT_OTA_RECEIVING: return otaNextSeq == 0 ? "ready" : "receiving";
+        case MQTT_OTA_DONE: return "done";
+        case MQTT_OTA_FAILED: return "failed";
+        default: return "idle";
+    }
+}
+
+static void failMqttOta(const char* reason) {
+    if (otaState == MQTT_OTA_RECEIVING) {
+        Update.end(false);  // Drops what was written, the running image stays
+        endOtaProgress(false);
+    }
+    otaState = MQTT_OTA_FAILED;
+    otaError = reason;
+    otaAckPending = true;
+    printBothf("MQTT firmware update failed: %s", reason);
+}
+
+static void beginMqttOta(const uint8_t* payload, unsigned int length) {
+    if (otaState == MQTT_OTA_RECEIVING) {
+        printBoth("MQTT firmware update restarted");
+        Update.end(false);
+        endOtaProgress(false);
+        otaState = MQTT_OTA_IDLE;
+    }
+
+    StaticJsonDocument<192> doc;
+    if (deserializeJson(doc, payload, length) || !doc["size"].is<uint32_t>() ||
+        !parseSha256(doc["sha256"], otaSha256)) {
+        failMqttOta("begin needs size and sha256");
+        return;
+    }
+    uint32_t size = doc["size"];
+    uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    if (size == 0 || size > maxSketchSpace) {
+        failMqttOta("image too large");
+        return;
+    }
+    if (Update.isRunning()) {
+        failMqttOta("another update is running");
+        return;
+    }
+    // Sized to the free space like the other paths: end(false) only drops an image
+    // that isn't finished, so a bad one must never fill the whole size
+    if (!Update.begin(maxSketchSpace)) {
+        failMqttOta("update begin failed");
+        return;
+    }
+
+    otaState = MQTT_OTA_RECEIVING;
+    otaSize = size;
+    otaReceived = 0;
+    otaNextSeq = 0;
+    otaError = nullptr;
+    otaGapReported = false;
+    otaLastChunk = millis();
+    br_sha256_init(&otaHash);
+    beginOtaProgress("MQTT update");
+    printBothf("MQTT firmware update started, %u bytes", (unsigned)size);
+
+    // Chunks don't fit the default buffer. Last, the payload lives in the old one.
+    if (otaDefaultBufferSize == 0) {
+        otaDefaultBufferSize = mqttClient.getBufferSize();
+    }
+    if (!mqttClient.setBufferSize(MQTT_OTA_PACKET_SIZE)) {
+        failMqttOta("out of memory");
+        return;
+    }
+    otaAckPending = true;
+}
+
+static void finishMqttOta() {
+    uint8_t digest[32];
+    br_sha256_out(&otaHash, digest);
+    if (memcmp(digest, otaSha256, sizeof(digest)) != 0) {
+        failMqttOta("SHA-256 mismatch");
+        return;
+    }
+    if (!Update.end(true)) {
+        endOtaProgress(false);
+        otaState = MQTT_OTA_FAILED;  // end() has already dropped the image
+        failMqttOta("update end failed");
+        return;
+    }
+    endOtaProgress(true);
+    otaState = MQTT_OTA_DONE;
+    otaAckPending = true;
+    printBoth("MQTT firmware update complete");
+    // The final ack goes out on the next loop() pass, well before this runs
+    deferJob(restartAfterUpdate, DEFERRED_RESPONSE_GRACE_MS);
+}
+
+static void receiveChunk(const uint8_t* payload, unsigned int length) {
+    if (otaState != MQTT_OTA_RECEIVING) {
+        if (otaState != MQTT_OTA_DONE) {
+            otaAckPending = true;  // Tell the sender there is nothing to resume
+        }
+        return;
+    }
+    if (length < 4) {
+        return;
+    }
+    uint32_t seq = payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((uint32_t)payload[3] << 24);
+    if (seq != otaNextSeq) {
+        // Lost or repeated chunks: the ack says where to go on from
+        if (seq < otaNextSeq || !otaGapReported) {
+            otaGapReported = seq > otaNextSeq;
+            otaAckPending = true;
+        }
+        return;
+    }
+
+    size_t dataLength = length - 4;
+    if (dataLength > otaSize - otaReceived) {
+        failMqttOta("chunk runs past the image");
+        return;
+    }
+    if (Update.write(const_cast<uint8_t*>(payload + 4), dataLength) != dataLength) {
+        failMqttOta("flash write");
+        return;
+    }
+    br_sha256_update(&otaHash, payload + 4, dataLength);
+    otaReceived += dataLength;
+    otaNextSeq++;
+    otaGapReported = false;
+    otaLastChunk = millis();
+    reportOtaProgress(otaReceived, otaSize);
+
+    if (otaReceived == otaSize) {
+        finishMqttOta();
+    } else if (otaNextSeq % MQTT_OTA_WINDOW == 0) {
+        otaAckPending = true;
+    }
+}
+
+void subscribeMqttOta() {
+    char topic[64];
+    otaTopic("+", topic, sizeof(topic));
+    mqttClient.subscribe(topic, 1);
+}
+
+bool handleMqttOtaMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+    char prefix[64];
+    size_t prefixLength = otaTopic("", prefix, sizeof(prefix));
+    if (strncmp(topic, prefix, prefixLength) != 0) {
+        return false;
+    }
+
+    const char* name = topic + prefixLength;
+    if (strcmp(name, "chunk") == 0) {
+        receiveChunk(payload, length);
+    } else if (strcmp(name, "begin") == 0) {
+        beginMqttOta(payload, length);
+    } else if (strcmp(name, "abort") == 0 && otaState == MQTT_OTA_RECEIVING) {
+        failMqttOta("aborted");
+    }
+    // Anything else, like our own acks coming back, is ignored
+    return true;
+}
+
+void handleMqttOta() {
+    if (otaState == MQTT_OTA_RECEIVING && millis() - otaLastChunk > MQTT_OTA_TIMEOUT_MS) {
+        failMqttOta("timeout");
+    }
+    if (otaState != MQTT_OTA_RECEIVING && otaDefaultBufferSize != 0) {
+        mqttClient.setBufferSize(otaDefaultBufferSize);
+        otaDefaultBufferSize = 0;
+    }
+    if (!otaAckPending || !mqttClient.connected()) {
+        return;
+    }
+
+    StaticJsonDocument<160> doc;
+    doc["state"] = otaStateName();
+    doc["next"] = otaNextSeq;
+    doc["window"] = MQTT_OTA_WINDOW;
+    doc["chunk"] = MQTT_OTA_CHUNK_SIZE;
+    if (otaError) {
+        doc["error"] = otaError;
+    }
+    char payload[160];
+    size_t length = serializeJson(doc, payload, sizeof(payload));
+    char topic[64];
+    otaTopic("ack", topic, sizeof(topic));
+    if (mqttClient.publish(topic, (const uint8_t*)payload, length, false)) {
+        otaAckPending = false;
+    }
+}
@@ -0,0 +1,217 @@
+#include "Notifier.h"
+#include "WiFiSetup.h"
+#include <lwip/dns.h>
+
+enum NotifyState : uint8_t {
+    NOTIFY_IDLE,
+    NOTIFY_RESOLVING,
+    NOTIFY_CONNECTING,
+    NOTIFY_AWAITING_RESPONSE
+};
+
+struct NotifyItem {
+    char message[NOTIFY_MESSAGE_SIZE];
+    uint8_t attempts;
+};
+
+uint32_t notifySent = 0;
+uint32_t notifyFailed = 0;
+uint32_t notifyDropped = 0;
+
+static NotifyItem notifyQueue[NOTIFY_QUEUE_SIZE];
+static uint8_t notifyHead = 0;
+static uint8_t notifyCount = 0;
+
+static NotifyState notifyState = NOTIFY_IDLE;
+static WiFiClient notifyClient;
+static char notifyUrl[sizeof(notifyConfig.url) + 32];  // Of the attempt in progress
+static IPAddress notifyServerIp;
+static int8_t notifyLookupResult = 0;   // 0 while waiting, 1 found, -1 no such host
+static uint8_t notifyLookupId = 0;      // Tags each lookup, lwIP may answer one that was given up on
+static unsigned long notifyLastAttempt = 0;
+static unsigned long notifyRetryDelay = 0;
+static unsigned long notifyRequestStart = 0;
+static char notifyStatusLine[32];
+static uint8_t notifyStatusLen = 0;
+
+bool notifyEnqueue(const char* message) {
+    if (notifyCount == NOTIFY_QUEUE_SIZE) {
+        notifyDropped++;
+        printBoth("Notification queue full - message dropped");
+        return false;
+    }
+
+    NotifyItem& item = notifyQueue[(notifyHead + notifyCount) % NOTIFY_QUEUE_SIZE];
+    strlcpy(item.message, message, sizeof(item.message));
+    item.attempts = 0;
+    notifyCount++;
+    return true;
+}
+
+static void getNotifyUrl(char* url, size_t size) {
+    if (notifyConfig.url[0] != '\0') {
+        strlcpy(url, notifyConfig.url, size);
+        return;
+    }
+    // Default to the device's ntfy.sh topic
+    String macAddress = WiFi.macAddress();
+    macAddress.replace(":", "");
+    snprintf(url, size, "http://ntfy.sh/%s", macAddress.c_str());
+}
+
+static void popNotification() {
+    notifyHead = (notifyHead + 1) % NOTIFY_QUEUE_SIZE;
+    notifyCount--;
+    notifyRetryDelay = 0;
+}
+
+static void finishAttempt(bool success, const char* reason) {
+    notifyClient.stop();
+    notifyState = NOTIFY_IDLE;
+
+    if (success) {
+        notifySent++;
+        popNotification();
+        return;
+    }
+
+    NotifyItem& item = notifyQueue[notifyHead];
+    item.attempts++;
+    if (item.attempts >= NOTIFY_MAX_ATTEMPTS) {
+        notifyFailed++;
+        printBothf("Notification dropped after %d attempts (%s)", item.attempts, reason);
+        popNotification();
+        return;
+    }
+
+    // Exponential backoff between attempts
+    notifyRetryDelay = (unsigned long)NOTIFY_RETRY_BASE_MS << (item.attempts - 1);
+    if (notifyRetryDelay > NOTIFY_RETRY_MAX_MS) {
+        notifyRetryDelay = NOTIFY_RETRY_MAX_MS;
+    }
+    printBothf("Notification failed (%s), retry in %lu s", reason, notifyRetryDelay / 1000);
+}
+
+static void notifyHostFound(const char* name, const ip_addr_t* addr, void* arg) {
+    if ((uintptr_t)arg != notifyLookupId) {
+        return;
+    }
+    if (addr) {
+        notifyServerIp = IPAddress(addr);
+        notifyLookupResult = 1;
+    } else {
+        notifyLookupResult = -1;
+    }
+}
+
+// Starts the host lookup, lwIP answers in notifyHostFound while loop() goes on
+static void startRequest() {
+    char host[64];
+    uint16_t port;
+    const char* path;
+
+    getNotifyUrl(notifyUrl, sizeof(notifyUrl));
+    if (!parseHttpUrl(notifyUrl, host, sizeof(host), port, path)) {
+        finishAttempt(false, "bad URL");
+        return;
+    }
+
+    notifyLookupResult = 0;
+    notifyLookupId++;
+    notifyRequestStart = millis();
+    notifyState = NOTIFY_RESOLVING;
+    ip_addr_t addr;
+    err_t err = dns_gethostbyname(host, &addr, notifyHostFound, (void*)(uintptr_t)notifyLookupId);
+    if (err == ERR_OK) {
+        // An address or a name lwIP still has cached
+        notifyServerIp = IPAddress(&addr);
+        notifyLookupResult = 1;
+    } else if (err != ERR_INPROGRESS) {
+        finishAttempt(false, "DNS");
+    }
+}
+
+static void checkLookup() {
+    if (notifyLookupResult > 0) {
+        notifyState = NOTIFY_CONNECTING;
+    } else if (notifyLookupResult < 0 || millis() - notifyRequestStart > NOTIFY_CONNECT_TIMEOUT_MS) {
+        finishAttempt(false, "DNS");
+    }
+}
+
+// A pass of its own, the TCP connect waits up to NOTIFY_CONNECT_TIMEOUT_MS
+static void sendRequest() {
+    char host[64];
+    uint16_t port;
+    const char* path;
+    parseHttpUrl(notifyUrl, host, sizeof(host), port, path);
+
+    notifyClient.setTimeout(NOTIFY_CONNECT_TIMEOUT_MS);
+    if (!notifyClient.connect(notifyServerIp, port)) {
+        finishAttempt(false, "connect");
+        return;
+    }
+
+    const char* message = notifyQueue[notifyHead].message;
+    notifyClient.printf("POST %s HTTP/1.0\r\n"
+                        "Host: %s\r\n"
+                        "Content-Type: text/plain\r\n"
+                        "Content-Length: %u\r\n"
+                        "Connection: close\r\n\r\n",
+                        path, host, (unsigned)strlen(message));
+    notifyClient.print(message);
+
+    notifyStatusLen = 0;
+    notifyRequestStart = millis();
+    notifyState = NOTIFY_AWAITING_RESPONSE;
+}
+
+void handleNotifier() {
+    if (notifyState == NOTIFY_IDLE) {
+        if (notifyCount == 0 || WiFi.status() != WL_CONNECTED) {
+            return;
+        }
+        if (millis() - notifyLastAttempt < notifyRetryDelay) {
+            return;
+        }
+        notifyLastAttempt = millis();
+        startRequest();
+        return;
+    }
+    if (notifyState == NOTIFY_RESOLVING) {
+        checkLookup();
+        return;
+    }
+    if (notifyState == NOTIFY_CONNECTING) {
+        sendRequest();
+        return;
+    }
+
+    // Only the status line matters, collect it as it arrives
+    bool lineComplete = false;
+    while (!lineComplete && notifyClient.available()) {
+        char c = notifyClient.read();
+        if (c == '\n' || notifyStatusLen == sizeof(notifyStatusLine) - 1) {
+            lineComplete = true;
+        } else if (c != '\r') {
+            notifyStatusLine[notifyStatusLen++] = c;
+        }
+    }
+
+    if (lineComplete) {
+        notifyStatusLine[notifyStatusLen] = '\0';
+        const char* space = strchr(notifyStatusLine, ' ');
+        int code = space ? atoi(space + 1) : 0;
+        if (code >= 200 && code < 300) {
+            finishAttempt(true, nullptr);
+        } else {
+            char reason[16];
+            snprintf(reason, sizeof(reason), "HTTP %d", code);
+            finishAttempt(false, reason);
+        }
+    } else if (!notifyClient.connected() && !notifyClient.available()) {
+        finishAttempt(false, "closed");
+    } else if (millis() - notifyRequestStart > NOTIFY_RESPONSE_TIMEOUT_MS) {
+        finishAttempt(false, "timeout");
+    }
+}
@@ -0,0 +1,719 @@
+#include "OtaUpdate.h"
+#include "WiFiSetup.h"
+#include "DeltaPatch.h"
+#include "UpdateSigningKey.h"
+#include <WiFiClientSecure.h>
+#include <lwip/dns.h>
+
+extern void displayOtaProgress(const char* progress);
+extern void updateTimeDisplay();
+
+enum OtaTarget : uint8_t {
+    OTA_TARGET_MANIFEST,
+    OTA_TARGET_DELTA,
+    OTA_TARGET_IMAGE
+};
+
+// What manifest.json says about one of the files, hash as raw bytes
+struct OtaExpected {
+    bool known;
+    int32_t size;
+    uint8_t sha256[32];
+};
+
+#ifdef OTA_SIGNING_KEY
+static BearSSL::PublicKey otaSigningKey(OTA_SIGNING_KEY);
+static BearSSL::HashSHA256 otaSigningHash;
+static BearSSL::SigningVerifier otaSigningVerifier(&otaSigningKey);
+#endif
+
+static OtaState otaState = OTA_IDLE;
+static OtaTarget otaTarget = OTA_TARGET_IMAGE;
+static bool otaForce = false;
+static WiFiClient otaPlainClient;
+static BearSSL::WiFiClientSecure* otaSecureClient = nullptr;    // Only while an https download runs
+static WiFiClient* otaClient = &otaPlainClient;
+static char otaUrl[sizeof(firmwareConfig.update_url)];          // Being downloaded
+static char otaImageUrl[sizeof(firmwareConfig.update_url)];     // Full image, the fallback for a delta
+static char otaError[48];
+static IPAddress otaServerIp;              // From the lookup for otaUrl
+static bool otaLookupStarted = false;
+static int8_t otaLookupResult = 0;         // 0 while waiting, 1 found, -1 no such host
+static uint8_t otaLookupId = 0;            // Tags each lookup, lwIP may answer one that was given up on
+static DeltaPatch* otaPatch = nullptr;     // Only while a delta is being applied
+static uint16_t otaPending = 0;            // otaBuffer bytes the patch has yet to take
+static uint16_t otaPendingEnd = 0;
+
+static char otaLine[128];                  // Status line or header being collected
+static uint8_t otaLineLength = 0;
+static int otaStatusCode = 0;
+static int32_t otaContentLength = -1;      // -1 until the server sends one
+
+static uint32_t otaReceived = 0;
+static unsigned long otaStarted = 0;
+static unsigned long otaLastData = 0;
+static unsigned long otaLastProgress = 0;
+static uint8_t otaBuffer[OTA_BUFFER_SIZE];    // Also collects the manifest
+
+static char otaManifestEtag[64];           // Sent as If-None-Match, kept while no update is needed
+static char otaResponseEtag[64];           // From the manifest being read
+static float otaLatestVersion = 0;         // From the last manifest, 0 until one was read
+static OtaExpected otaExpectedImage;       // The update URL's file
+static OtaExpected otaExpectedBuild;       // firmware.bin, what a delta must produce
+static OtaExpected otaExpectedDelta;       // firmware.delta itself
+static br_sha256_context otaHash;
+static bool otaChecked = false;
+static unsigned long otaLastCheck = 0;
+
+static bool otaBusy() {
+    return otaState == OTA_RESOLVING || otaState == OTA_CONNECTING || otaState == OTA_HEADERS ||
+           otaState == OTA_DOWNLOADING;
+}
+
+static const char* otaStateName(OtaState state) {
+    switch (state) {
+        case OTA_RESOLVING: return "resolving";
+        case OTA_CONNECTING: return "connecting";
+        case OTA_HEADERS: return "headers";
+        case OTA_DOWNLOADING: return "downloading";
+        case OTA_FAILED: return "failed";
+        default: return "idle";
+    }
+}
+
+static float otaRate() {
+    unsigned long elapsed = millis() - otaStarted;
+    return elapsed > 0 ? otaReceived / 1.024f / elapsed : 0;
+}
+
+// TLS buffers take about 20 KB, they are only kept for the download
+static void closeOtaClient() {
+    otaClient->stop();
+    otaClient = &otaPlainClient;
+    delete otaSecureClient;
+    otaSecureClient = nullptr;
+}
+
+// Every request starts with looking up the host of otaUrl
+static void beginOtaRequest() {
+    otaLookupStarted = false;
+    otaLastData = millis();
+    otaState = OTA_RESOLVING;
+}
+
+static void failPullOta(const char* reason) {
+    closeOtaClient();
+    if (otaState == OTA_DOWNLOADING && otaTarget != OTA_TARGET_MANIFEST) {
+        Update.end(false);  // Drops what was written, the running image stays
+    }
+
+    // Whatever went wrong with the delta, the full image still works
+    if (otaPatch) {
+        delete otaPatch;
+        otaPatch = nullptr;
+        printBothf("Delta update not used (%s), downloading the full image", reason);
+        strlcpy(otaUrl, otaImageUrl, sizeof(otaUrl));
+        otaTarget = OTA_TARGET_IMAGE;
+        beginOtaRequest();
+        return;
+    }
+
+    strlcpy(otaError, reason, sizeof(otaError));
+    otaState = OTA_FAILED;
+    if (otaTarget == OTA_TARGET_MANIFEST && !otaForce) {
+        // A background check stays off the display
+        printBothf("Firmware update check failed: %s", reason);
+        return;
+    }
+    printBothf("Firmware download failed: %s", reason);
+    displaySetupMessage("Update Failed");
+}
+
+// name in the same directory as url, false if it doesn't fit
+static bool siblingUrl(const char* url, const char* name, char* out, size_t size) {
+    const char* slash = strrchr(url, '/');
+    if (!slash || (size_t)(slash - url) + 1 + strlen(name) >= size) {
+        return false;
+    }
+    size_t prefix = slash - url + 1;
+    memcpy(out, url, prefix);
+    strcpy(out + prefix, name);
+    return true;
+}
+
+// The firmware itself: the delta from the previous release first if there may be one,
+// it falls back to the image
+static void startImageDownload(bool tryDelta) {
+    if (tryDelta && siblingUrl(otaImageUrl, "firmware.delta", otaUrl, sizeof(otaUrl))) {
+        otaPatch = new DeltaPatch();
+        otaTarget = OTA_TARGET_DELTA;
+    } else {
+        strlcpy(otaUrl, otaImageUrl, sizeof(otaUrl));
+        otaTarget = OTA_TARGET_IMAGE;
+    }
+    beginOtaRequest();
+    printBothf("Firmware update from %s", otaImageUrl);
+    if (!isUpdateSigningEnabled()) {
+        printBoth("No update signing key in this firmware, the image is not authenticated");
+    }
+}
+
+static void drawOtaProgress(uint32_t done, uint32_t total) {
+    char progress[8];
+    if (total > 0) {
+        snprintf(progress, sizeof(progress), "%u%%", (unsigned)((uint64_t)done * 100 / total));
+    } else {
+        snprintf(progress, sizeof(progress), "%uK", (unsigned)(done / 1024));
+    }
+    displayOtaProgress(progress);
+    otaLastProgress = millis();
+}
+
+static void showOtaProgress() {
+    if (otaPatch && otaPatch->imageSize() > 0) {
+        // Copies from the running image make the patch bytes a poor measure
+        drawOtaProgress(otaPatch->written(), otaPatch->imageSize());
+    } else {
+        drawOtaProgress(otaReceived, otaContentLength > 0 ? otaContentLength : 0);
+    }
+}
+
+static void otaHostFound(const char* name, const ip_addr_t* addr, void* arg) {
+    if ((uintptr_t)arg != otaLookupId) {
+        return;
+    }
+    if (addr) {
+        otaServerIp = IPAddress(addr);
+        otaLookupResult = 1;
+    } else {
+        otaLookupResult = -1;
+    }
+}
+
+// lwIP answers in otaHostFound, a pass only looks at the result
+static void resolvePullOta() {
+    char host[64];
+    uint16_t port;
+    const char* path;
+    if (!parseHttpUrl(otaUrl, host, sizeof(host), port, path, true)) {
+        failPullOta("bad URL");
+        return;
+    }
+
+    if (!otaLookupStarted) {
+        otaLookupStarted = true;
+        otaLookupResult = 0;
+        otaLookupId++;
+        ip_addr_t addr;
+        err_t err = dns_gethostbyname(host, &addr, otaHostFound, (void*)(uintptr_t)otaLookupId);
+        if (err == ERR_OK) {
+            // An address or a name lwIP still has cached
+            otaServerIp = IPAddress(&addr);
+            otaLookupResult = 1;
+        } else if (err != ERR_INPROGRESS) {
+            failPullOta("DNS");
+            return;
+        }
+    }
+
+    if (otaLookupResult > 0) {
+        otaState = OTA_CONNECTING;
+    } else if (otaLookupResult < 0 || millis() - otaLastData > OTA_CONNECT_TIMEOUT_MS) {
+        failPullOta("DNS");
+    }
+}
+
+static void connectPullOta() {
+    char host[64];
+    uint16_t port;
+    const char* path;
+    if (!parseHttpUrl(otaUrl, host, sizeof(host), port, path, true)) {
+        failPullOta("bad URL");
+        return;
+    }
+
+    if (strncmp(otaUrl, "https://", 8) == 0) {
+        // The server isn't authenticated. With a signing key the image is, Update.end() checks it.
+        otaSecureClient = new BearSSL::WiFiClientSecure();
+        otaSecureClient->setInsecure();
+        otaSecureClient->setTimeout(OTA_CONNECT_TIMEOUT_MS);
+        otaClient = otaSecureClient;
+        // By name so the server gets SNI, the lookup just cached it
+        if (!otaSecureClient->connect(host, port)) {
+            failPullOta("TLS connect");
+            return;
+        }
+    } else {
+        otaClient->setTimeout(OTA_CONNECT_TIMEOUT_MS);
+        if (!otaClient->connect(otaServerIp, port)) {
+            failPullOta("connect");
+            return;
+        }
+    }
+
+    // HTTP/1.0 keeps the body free of chunked encoding
+    otaClient->printf("GET %s HTTP/1.0\r\n"
+                     "Host: %s\r\n",
+                     path, host);
+    if (otaTarget == OTA_TARGET_MANIFEST && !otaForce && otaManifestEtag[0] != '\0') {
+        // An unchanged manifest costs a 304 and no body
+        otaClient->printf("If-None-Match: %s\r\n", otaManifestEtag);
+    }
+    otaClient->print("Connection: close\r\n\r\n");
+
+    otaLineLength = 0;
+    otaStatusCode = 0;
+    otaContentLength = -1;
+    otaResponseEtag[0] = '\0';
+    otaLastData = millis();
+    otaState = OTA_HEADERS;
+}
+
+static void beginOtaBody() {
+    if (otaTarget == OTA_TARGET_MANIFEST) {
+        if (otaStatusCode == 304) {
+            closeOtaClient();
+            otaState = OTA_IDLE;
+            printBoth("Firmware manifest unchanged");
+            return;
+        }
+        if (otaStatusCode == 404 && otaForce) {
+            // Nothing published to check against, update anyway as asked
+            closeOtaClient();
+            printBoth("No firmware manifest, the image can't be verified");
+            startImageDownload(true);
+            return;
+        }
+        if (otaStatusCode == 200) {
+            otaReceived = 0;
+            otaState = OTA_DOWNLOADING;
+            return;
+        }
+    }
+
+    if (otaStatusCode != 200) {
+        char reason[16];
+        snprintf(reason, sizeof(reason), "HTTP %d", otaStatusCode);
+        failPullOta(reason);
+        return;
+    }
+
+    uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    if (otaContentLength > (int32_t)maxSketchSpace) {
+        failPullOta("image too large");
+        return;
+    }
+    const OtaExpected& expected = otaTarget == OTA_TARGET_DELTA ? otaExpectedDelta : otaExpectedImage;
+    if (expected.known && otaContentLength >= 0 && otaContentLength != expected.size) {
+        failPullOta("size differs from manifest");
+        return;
+    }
+    // Sized to the free space, end(true) takes whatever actually arrived
+    if (!Update.begin(maxSketchSpace)) {
+        failPullOta(Update.getErrorString().c_str());
+        return;
+    }
+
+    otaReceived = 0;
+    otaPending = 0;
+    otaPendingEnd = 0;
+    otaStarted = millis();
+    otaState = OTA_DOWNLOADING;
+    br_sha256_init(&otaHash);
+    printBothf("Downloading firmware %s, %d bytes", otaPatch ? "delta" : "image", (int)otaContentLength);
+    showOtaProgress();
+}
+
+static void readOtaHeaders() {
+    while (otaState == OTA_HEADERS && otaClient->available()) {
+        char c = otaClient->read();
+        otaLastData = millis();
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (otaLineLength < sizeof(otaLine) - 1) {
+                otaLine[otaLineLength++] = c;
+            }
+            continue;
+        }
+
+        otaLine[otaLineLength] = '\0';
+        if (otaLineLength == 0) {
+            beginOtaBody();
+        } else if (otaStatusCode == 0) {
+            const char* space = strchr(otaLine, ' ');
+            otaStatusCode = space ? atoi(space + 1) : -1;
+        } else if (strncasecmp(otaLine, "Content-Length:", 15) == 0) {
+            otaContentLength = atol(otaLine + 15);
+        } else if (otaTarget == OTA_TARGET_MANIFEST && strncasecmp(otaLine, "ETag:", 5) == 0) {
+            const char* value = otaLine + 5;
+            while (*value == ' ') value++;
+            strlcpy(otaResponseEtag, value, sizeof(otaResponseEtag));
+        }
+        otaLineLength = 0;
+    }
+}
+
+static void finishPullOta() {
+    closeOtaClient();
+    unsigned long elapsed = millis() - otaStarted;
+
+    // Nothing is committed unless it is the build the manifest describes
+    if (otaTarget == OTA_TARGET_IMAGE && otaExpectedImage.known) {
+        uint8_t digest[32];
+        br_sha256_out(&otaHash, digest);
+        if (memcmp(digest, otaExpectedImage.sha256, sizeof(digest)) != 0) {
+            failPullOta("SHA-256 mismatch");
+            return;
+        }
+    } else if (otaTarget == OTA_TARGET_DELTA) {
+        uint8_t digest[32];
+        br_sha256_out(&otaHash, digest);
+        if (otaExpectedDelta.known && memcmp(digest, otaExpectedDelta.sha256, sizeof(digest)) != 0) {
+            failPullOta("delta SHA-256 mismatch");
+            return;
+        }
+        if (otaExpectedBuild.known && memcmp(otaPatch->imageHash(), otaExpectedBuild.sha256, 32) != 0) {
+            failPullOta("delta is for another build");
+            return;
+        }
+    }
+
+    if (!Update.end(true)) {
+        otaState = OTA_FAILED;  // end() has already dropped the image
+        failPullOta(Update.getErrorString().c_str());
+        return;
+    }
+
+    printBothf("Firmware %s: %u bytes in %lu ms (%.1f KB/s)", otaPatch ? "rebuilt from delta" : "downloaded",
+               (unsigned)otaReceived, elapsed, otaRate());
+    displaySetupMessage("Update Success");
+    flushPendingConfig(true);  // Don't lose settings still waiting for their debounced commit
+    ESP.restart();
+}
+
+static void readOtaBody() {
+    // Bounded per pass so the display and the web server keep their turn
+    unsigned long passStart = millis();
+    while (millis() - passStart < OTA_PASS_BUDGET_MS) {
+        int available = otaClient->available();
+        if (available <= 0) {
+            break;
+        }
+        size_t want = available < (int)sizeof(otaBuffer) ? available : sizeof(otaBuffer);
+        if (otaContentLength >= 0 && want > (uint32_t)otaContentLength - otaReceived) {
+            want = otaContentLength - otaReceived;
+        }
+        size_t got = otaClient->read(otaBuffer, want);
+        if (Update.write(otaBuffer, got) != got) {
+            failPullOta("flash write");
+            return;
+        }
+        br_sha256_update(&otaHash, otaBuffer, got);
+        otaReceived += got;
+        otaLastData = millis();
+
+        if (otaContentLength >= 0 && otaReceived >= (uint32_t)otaContentLength) {
+            finishPullOta();
+            return;
+        }
+    }
+
+    if (millis() - otaLastProgress >= OTA_PROGRESS_INTERVAL_MS) {
+        showOtaProgress();
+    }
+
+    if (!otaClient->connected() && !otaClient->available()) {
+        // Without a Content-Length the end of the connection is the end of the image
+        if (otaContentLength < 0) {
+            finishPullOta();
+        } else {
+            failPullOta("connection closed");
+        }
+    }
+}
+
+bool parseSha256(const char* hex, uint8_t* out) {
+    if (!hex || strlen(hex) != 64) {
+        return false;
+    }
+    for (uint8_t i = 0; i < 32; i++) {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        char* end;
+        out[i] = strtoul(byte, &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void readExpected(JsonVariantConst entry, OtaExpected& expected) {
+    expected.known = entry["size"].is<int32_t>() && parseSha256(entry["sha256"], expected.sha256);
+    expected.size = entry["size"] | -1;
+}
+
+// {"version": 0.2, "size": ..., "sha256": "...", "files": {"firmware.bin.gz": {"size": ..., "sha256": "..."}}}
+static void parseManifest(size_t length) {
+    StaticJsonDocument<512> doc;
+    if (deserializeJson(doc, (char*)otaBuffer, length) || !doc["version"].is<float>()) {
+        failPullOta("bad manifest");
+        return;
+    }
+
+    otaLatestVersion = doc["version"];
+    readExpected(doc.as<JsonVariantConst>(), otaExpectedBuild);
+    const char* slash = strrchr(otaImageUrl, '/');
+    JsonVariantConst file = doc["files"][slash ? slash + 1 : otaImageUrl];
+    if (!file.isNull()) {
+        readExpected(file, otaExpectedImage);
+    } else if (slash && strcmp(slash + 1, "firmware.bin") == 0) {
+        otaExpectedImage = otaExpectedBuild;
+    }
+
+    if (otaLatestVersion <= version + 0.0001f && !otaForce) {
+        // Until it changes the server can answer the next check with a 304
+        strlcpy(otaManifestEtag, otaResponseEtag, sizeof(otaManifestEtag));
+        otaState = OTA_IDLE;
+        printBothf("Firmware %.2f is up to date", version);
+        return;
+    }
+    printBothf("Firmware %.2f available, running %.2f", otaLatestVersion, version);
+    if (!otaForce && !firmwareConfig.auto_update) {
+        // Reported by /api/ota, installed from the System page
+        strlcpy(otaManifestEtag, otaResponseEtag, sizeof(otaManifestEtag));
+        otaState = OTA_IDLE;
+        return;
+    }
+    if (!otaExpectedImage.known) {
+        printBoth("Manifest doesn't list the update URL's file, the image can't be verified");
+    }
+    otaManifestEtag[0] = '\0';
+    // Only a delta the manifest lists is worth a request
+    JsonVariantConst delta = doc["files"]["firmware.delta"];
+    if (!delta.isNull()) {
+        readExpected(delta, otaExpectedDelta);
+    }
+    startImageDownload(!delta.isNull());
+}
+
+static void readManifest() {
+    while (otaClient->available()) {
+        if (otaReceived == sizeof(otaBuffer) - 1) {
+            failPullOta("manifest too large");
+            return;
+        }
+        int got = otaClient->read(otaBuffer + otaReceived, sizeof(otaBuffer) - 1 - otaReceived);
+        if (got <= 0) {
+            break;
+        }
+        otaReceived += got;
+        otaLastData = millis();
+    }
+
+    bool complete = otaContentLength >= 0 && otaReceived >= (uint32_t)otaContentLength;
+    if (complete || (!otaClient->connected() && !otaClient->available())) {
+        closeOtaClient();
+        parseManifest(otaReceived);
+    }
+}
+
+// Feeds the download through the patch, which gets its share of the pass for flash work
+static void readOtaPatch() {
+    unsigned long passStart = millis();
+    while (millis() - passStart < OTA_PASS_BUDGET_MS) {
+        if (otaPatch->busy()) {
+            otaPatch->step();
+            otaLastData = millis();  // Working on flash is not a stall
+        } else if (otaPending < otaPendingEnd) {
+            otaPending += otaPatch->feed(otaBuffer + otaPending, otaPendingEnd - otaPending);
+        } else {
+            int available = otaClient->available();
+            if (available <= 0) {
+                break;
+            }
+            int got = otaClient->read(otaBuffer, available < (int)sizeof(otaBuffer) ? available : sizeof(otaBuffer));
+            if (got <= 0) {
+                break;
+            }
+            br_sha256_update(&otaHash, otaBuffer, got);
+            otaPending = 0;
+            otaPendingEnd = got;
+            otaReceived += got;
+            otaLastData = millis();
+        }
+
+        if (otaPatch->failed()) {
+            failPullOta(otaPatch->error());
+            return;
+        }
+        if (otaPatch->complete()) {
+            finishPullOta();
+            return;
+        }
+    }
+
+    if (millis() - otaLastProgress >= OTA_PROGRESS_INTERVAL_MS) {
+        showOtaProgress();
+    }
+
+    if (!otaPatch->busy() && otaPending == otaPendingEnd && !otaClient->connected() && !otaClient->available()) {
+        failPullOta("connection closed");
+    }
+}
+
+void setupUpdateSigning() {
+#ifdef OTA_SIGNING_KEY
+    Update.installSignature(&otaSigningHash, &otaSigningVerifier);
+    printBoth("Firmware updates must be signed");
+#endif
+}
+
+bool isUpdateSigningEnabled() {
+#ifdef OTA_SIGNING_KEY
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* startPullOta(const char* url, bool force) {
+    if (otaBusy() || Update.isRunning()) {
+        return "An update is already running.";
+    }
+    char host[64];
+    uint16_t port;
+    const char* path;
+    if (!parseHttpUrl(url, host, sizeof(host), port, path, true)) {
+        return "The update URL is not an http:// or https:// URL.";
+    }
+    strlcpy(otaImageUrl, url, sizeof(otaImageUrl));
+    otaForce = force;
+    otaError[0] = '\0';
+    otaReceived = 0;
+    otaExpectedImage.known = false;
+    otaExpectedBuild.known = false;
+    otaExpectedDelta.known = false;
+    if (siblingUrl(url, "manifest.json", otaUrl, sizeof(otaUrl))) {
+        otaTarget = OTA_TARGET_MANIFEST;
+        beginOtaRequest();
+    } else {
+        startImageDownload(false);
+    }
+    return nullptr;
+}
+
+bool isPullOtaRunning() {
+    return otaBusy() && otaTarget != OTA_TARGET_MANIFEST;
+}
+
+// Background check for a newer release, only while nothing else is going on
+static void checkForUpdate() {
+    unsigned long interval = otaChecked ? OTA_CHECK_INTERVAL_MS : OTA_FIRST_CHECK_MS;
+    if (millis() - otaLastCheck < interval || firmwareConfig.update_url[0] == '\0' || WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+    otaChecked = true;
+    otaLastCheck = millis();
+    const char* error = startPullOta(firmwareConfig.update_url, false);
+    if (error) {
+        printBothf("Update check skipped: %s", error);
+    }
+}
+
+void handlePullOta() {
+    switch (otaState) {
+        case OTA_RESOLVING:
+            resolvePullOta();
+            break;
+        case OTA_CONNECTING:
+            connectPullOta();
+            break;
+        case OTA_HEADERS:
+            readOtaHeaders();
+            if (otaState == OTA_HEADERS && !otaClient->connected() && !otaClient->available()) {
+                failPullOta("no response");
+            }
+            break;
+        case OTA_DOWNLOADING:
+            if (otaTarget == OTA_TARGET_MANIFEST) {
+                readManifest();
+            } else if (otaPatch) {
+                readOtaPatch();
+            } else {
+                readOtaBody();
+            }
+            break;
+        default:
+            checkForUpdate();
+            return;
+    }
+
+    if (otaBusy() && millis() - otaLastData > OTA_STALL_TIMEOUT_MS) {
+        failPullOta("timeout");
+    }
+}
+
+static const char* pushSource = nullptr;   // While a push update runs
+static uint32_t pushDone = 0;
+static unsigned long pushStarted = 0;
+
+void beginOtaProgress(const char* source) {
+    pushSource = source;
+    pushDone = 0;
+    pushStarted = millis();
+    otaLastProgress = 0;
+    displayOtaProgress("OTA");
+}
+
+void reportOtaProgress(uint32_t done, uint32_t total) {
+    pushDone = done;
+    // loop() doesn't run until the upload is over, keep the clock going from here
+    updateTimeDisplay();
+    // The SPI redraw costs more than a chunk takes to arrive
+    if (otaLastProgress == 0 || millis() - otaLastProgress >= OTA_PROGRESS_INTERVAL_MS) {
+        drawOtaProgress(done, total);
+    }
+}
+
+void endOtaProgress(bool ok) {
+    if (!pushSource) {
+        return;  // Failed before it started, e.g. ArduinoOTA authentication
+    }
+    unsigned long elapsed = millis() - pushStarted;
+    printBothf("Firmware %s %s: %u bytes in %lu ms (%.1f KB/s)", pushSource, ok ? "done" : "failed",
+               (unsigned)pushDone, elapsed, elapsed > 0 ? pushDone / 1.024f / elapsed : 0);
+    pushSource = nullptr;
+}
+
+bool isOtaInProgress() {
+    return pushSource != nullptr || isPullOtaRunning();
+}
+
+void handleOtaStatus() {
+    StaticJsonDocument<384> doc;
+    doc["state"] = otaStateName(otaState);
+    doc["version"] = version;
+    if (otaLatestVersion > 0) {
+        doc["latest"] = otaLatestVersion;
+        doc["available"] = otaLatestVersion > version + 0.0001f;
+    }
+    doc["auto_update"] = firmwareConfig.auto_update;
+    doc["url"] = (const char*)otaUrl;
+    doc["delta"] = otaPatch != nullptr;
+    // checked: the manifest's SHA-256, which only catches damage. verified: the signature.
+    doc["checked"] = otaTarget == OTA_TARGET_IMAGE ? otaExpectedImage.known : otaExpectedBuild.known;
+    doc["verified"] = isUpdateSigningEnabled();
+    doc["received"] = otaReceived;
+    if (otaContentLength >= 0) {
+        doc["size"] = otaContentLength;
+    }
+    if (otaState == OTA_DOWNLOADING) {
+        doc["kbps"] = otaRate();
+    }
+    if (otaError[0] != '\0') {
+        doc["error"] = (const char*)otaError;
+    }
+    sendJsonResponse(200, doc);
+}
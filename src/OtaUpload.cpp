@@ -0,0 +1,226 @@
+#include "OtaUpload.h"
+#include "OtaUpdate.h"
+#include "WiFiSetup.h"
+#include "DeferredJobs.h"
+
+// The session outlives the connections that feed it
+static bool sessionActive = false;
+static uint32_t sessionSize = 0;
+static uint32_t sessionImageCrc = 0;
+static uint32_t sessionOffset = 0;        // Bytes committed to Update
+static uint32_t sessionCrc = 0;           // Running CRC of the committed bytes
+static unsigned long sessionLastChunk = 0;
+
+// The chunk in flight, only written once it is complete and checks out
+static uint8_t* chunkBuffer = nullptr;
+static uint16_t chunkLength = 0;
+static uint32_t chunkCrc = 0;
+static int chunkStatus = 0;               // HTTP status for handleOtaUploadDone, 0 while receiving
+static const char* chunkError = nullptr;
+static bool sessionComplete = false;
+
+// zlib's CRC-32, so the host side can use zlib.crc32 and carry it across chunks
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static bool parseHex32(const String& text, uint32_t& value) {
+    if (text.length() == 0 || text.length() > 8) {
+        return false;
+    }
+    char* end;
+    value = strtoul(text.c_str(), &end, 16);
+    return *end == '\0';
+}
+
+static void rejectChunk(int status, const char* error) {
+    chunkStatus = status;
+    chunkError = error;
+}
+
+static void closeSession(bool ok) {
+    if (!ok && Update.isRunning()) {
+        Update.end(false);  // Drops what was written, the running image stays
+    }
+    endOtaProgress(ok);
+    free(chunkBuffer);
+    chunkBuffer = nullptr;
+    sessionActive = false;
+}
+
+static bool openSession(uint32_t size, uint32_t imageCrc) {
+    if (sessionActive) {
+        printBoth("Chunked upload restarted from offset 0");
+        closeSession(false);
+    }
+    if (Update.isRunning()) {
+        rejectChunk(409, "another update is running");
+        return false;
+    }
+    uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    if (size == 0 || size > maxSketchSpace) {
+        rejectChunk(413, "image too large");
+        return false;
+    }
+    chunkBuffer = (uint8_t*)malloc(OTA_UPLOAD_CHUNK_MAX);
+    if (!chunkBuffer) {
+        rejectChunk(503, "out of memory");
+        return false;
+    }
+    // Sized to the free space like the other paths: end(false) only drops an image
+    // that isn't finished, so one failing the image CRC must never fill the whole size
+    if (!Update.begin(maxSketchSpace)) {
+        free(chunkBuffer);
+        chunkBuffer = nullptr;
+        rejectChunk(500, "update begin failed");
+        return false;
+    }
+
+    sessionActive = true;
+    sessionSize = size;
+    sessionImageCrc = imageCrc;
+    sessionOffset = 0;
+    sessionCrc = 0;
+    sessionLastChunk = millis();
+    sessionComplete = false;
+    beginOtaProgress("chunked upload");
+    printBothf("Chunked upload started, %u bytes", (unsigned)size);
+    return true;
+}
+
+static void startChunk() {
+    chunkLength = 0;
+    chunkStatus = 0;
+    chunkError = nullptr;
+
+    uint32_t offset, size, imageCrc;
+    if (!server.hasArg("offset") || !server.hasArg("size") ||
+        !parseHex32(server.arg("crc"), chunkCrc) || !parseHex32(server.arg("image"), imageCrc)) {
+        rejectChunk(400, "offset, size, crc and image are required");
+        return;
+    }
+    offset = strtoul(server.arg("offset").c_str(), nullptr, 10);
+    size = strtoul(server.arg("size").c_str(), nullptr, 10);
+
+    if (offset == 0) {
+        openSession(size, imageCrc);
+        return;
+    }
+    if (!sessionActive || size != sessionSize || imageCrc != sessionImageCrc) {
+        rejectChunk(409, "no upload of this image to resume");
+        return;
+    }
+    if (offset != sessionOffset) {
+        rejectChunk(409, "offset is not where the upload stands");
+    }
+}
+
+// The chunk is whole: check it, then it goes into flash and counts as committed
+static void commitChunk() {
+    if (chunkLength == 0 || chunkLength > sessionSize - sessionOffset) {
+        rejectChunk(400, "chunk doesn't fit the image");
+        return;
+    }
+    if (crc32Update(0, chunkBuffer, chunkLength) != chunkCrc) {
+        rejectChunk(422, "chunk CRC mismatch");
+        return;
+    }
+    if (Update.write(chunkBuffer, chunkLength) != chunkLength) {
+        printBothf("Chunked upload failed at %u: %s", (unsigned)sessionOffset, Update.getErrorString().c_str());
+        closeSession(false);
+        rejectChunk(500, "flash write");
+        return;
+    }
+    sessionCrc = crc32Update(sessionCrc, chunkBuffer, chunkLength);
+    sessionOffset += chunkLength;
+    sessionLastChunk = millis();
+    reportOtaProgress(sessionOffset, sessionSize);
+    chunkStatus = 200;
+
+    if (sessionOffset < sessionSize) {
+        return;
+    }
+    if (sessionCrc != sessionImageCrc) {
+        closeSession(false);
+        rejectChunk(422, "image CRC mismatch");
+        return;
+    }
+    if (!Update.end(true)) {
+        closeSession(false);
+        rejectChunk(500, "update end failed");
+        return;
+    }
+    closeSession(true);
+    sessionComplete = true;
+}
+
+void handleOtaUploadData() {
+    HTTPUpload& upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+        startChunk();
+    } else if (upload.status == UPLOAD_FILE_WRITE && chunkStatus == 0) {
+        if (chunkLength + upload.currentSize > OTA_UPLOAD_CHUNK_MAX) {
+            rejectChunk(413, "chunk too large");
+            return;
+        }
+        memcpy(chunkBuffer + chunkLength, upload.buf, upload.currentSize);
+        chunkLength += upload.currentSize;
+    } else if (upload.status == UPLOAD_FILE_END && chunkStatus == 0) {
+        commitChunk();
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+        // Only this chunk is lost, the session waits for the client to resume
+        chunkLength = 0;
+    }
+}
+
+void handleOtaUploadStatus() {
+    StaticJsonDocument<128> doc;
+    doc["active"] = sessionActive;
+    doc["offset"] = sessionActive ? sessionOffset : (sessionComplete ? sessionSize : 0);
+    doc["done"] = sessionComplete;    // Restarting into the new image
+    if (sessionActive) {
+        char image[9];
+        snprintf(image, sizeof(image), "%08x", (unsigned)sessionImageCrc);
+        doc["size"] = sessionSize;
+        doc["image"] = image;
+    }
+    sendJsonResponse(200, doc);
+}
+
+void handleOtaUploadDone() {
+    StaticJsonDocument<192> doc;
+    int status = chunkStatus;
+    if (status == 0) {
+        status = 400;   // No file part arrived
+        chunkError = "chunk missing";
+    }
+    doc["offset"] = sessionActive ? sessionOffset : (sessionComplete ? sessionSize : 0);
+    doc["size"] = sessionSize;
+    if (chunkError) {
+        doc["error"] = chunkError;
+    }
+    doc["done"] = sessionComplete;
+    sendJsonResponse(status, doc);
+    chunkStatus = 0;
+
+    if (sessionComplete) {
+        printBothf("Chunked upload complete, %u bytes", (unsigned)sessionSize);
+        displaySetupMessage("Update Success");
+        // Give the client some time to receive the response before rebooting
+        deferJob(restartAfterUpdate, DEFERRED_RESPONSE_GRACE_MS);
+    }
+}
+
+void handleOtaUpload() {
+    if (sessionActive && millis() - sessionLastChunk > OTA_UPLOAD_IDLE_TIMEOUT_MS) {
+        printBoth("Chunked upload abandoned, update dropped");
+        closeSession(false);
+    }
+}
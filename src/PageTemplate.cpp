@@ -0,0 +1,213 @@
+#include "PageTemplate.h"
+#include "WiFiSetup.h"
+#include "HeapStats.h"
+
+// Writes a placeholder value into the rest of the caller's buffer, anything
+// past the end is held over for the next read
+class ValuePrint : public Print {
+public:
+    ValuePrint(uint8_t* buffer, size_t size, size_t& length, String& overflow)
+        : _buffer(buffer), _size(size), _length(length), _overflow(overflow) {}
+
+    size_t write(uint8_t c) override {
+        if (_length < _size) {
+            _buffer[_length++] = c;
+        } else {
+            _overflow += (char)c;
+        }
+        return 1;
+    }
+
+private:
+    uint8_t* _buffer;
+    size_t _size;
+    size_t& _length;
+    String& _overflow;
+};
+
+// Renders a template a piece at a time, so it can be sent in chunks of any size
+// and picked up again later
+class TemplateReader {
+public:
+    TemplateReader(PGM_P page, const TemplateFiller& fill) : _p(page), _fill(fill), _heldOffset(0) {}
+
+    // Fills up to size bytes, returns 0 once the page is complete
+    size_t read(uint8_t* buffer, size_t size) {
+        size_t length = 0;
+        while (_heldOffset < _held.length() && length < size) {
+            buffer[length++] = _held[_heldOffset++];
+        }
+        if (_heldOffset == _held.length() && _heldOffset > 0) {
+            _held = String();
+            _heldOffset = 0;
+        }
+
+        char name[TEMPLATE_MAX_NAME];
+        char c;
+        while (length < size && (c = pgm_read_byte(_p)) != '\0') {
+            PGM_P next = placeholder(_p, name);
+            if (!next) {
+                buffer[length++] = c;
+                _p++;
+                continue;
+            }
+            _p = next;
+            ValuePrint out(buffer, size, length, _held);
+            _fill(out, name);
+        }
+        return length;
+    }
+
+private:
+    // Reads the name of a {{placeholder}} at p and returns where the text after
+    // it starts, or nullptr for anything else - malformed ones are sent as literal text
+    static PGM_P placeholder(PGM_P p, char* name) {
+        if (pgm_read_byte(p) != '{' || pgm_read_byte(p + 1) != '{') {
+            return nullptr;
+        }
+        size_t len = 0;
+        PGM_P q = p + 2;
+        char c;
+        while ((c = pgm_read_byte(q)) != '\0' && c != '}' && len < TEMPLATE_MAX_NAME - 1) {
+            name[len++] = c;
+            q++;
+        }
+        if (c != '}' || pgm_read_byte(q + 1) != '}') {
+            return nullptr;
+        }
+        name[len] = '\0';
+        return q + 2;
+    }
+
+    PGM_P _p;
+    TemplateFiller _fill;
+    String _held;
+    size_t _heldOffset;
+};
+
+#ifdef ASYNC_HTTP_SERVER
+void sendTemplate(int code, PGM_P page, const TemplateFiller& fill) {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(code, "text/html", "");
+
+    // Rendered across loop passes as the client takes it
+    TemplateReader reader(page, fill);
+    server.sendContentSource([reader](uint8_t* buffer, size_t size) mutable {
+        return reader.read(buffer, size);
+    });
+}
+
+void handleTemplateStreams() {
+    // The server's own content sources do this
+}
+#else
+// ESP8266WebServer ends a chunked response as soon as the handler returns, so a
+// page that doesn't go out within the handler's slice is sent close-delimited on
+// a copy of the client, from loop(). The copy keeps the connection open after the
+// server has let go of it.
+struct TemplateStream {
+    WiFiClient client;
+    TemplateReader* reader;         // nullptr while the slot is free
+    unsigned long lastWrite;
+};
+
+static TemplateStream templateStreams[TEMPLATE_MAX_STREAMS];
+
+static const char* statusText(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 409: return "Conflict";
+        case 500: return "Internal Server Error";
+        default: return "";
+    }
+}
+
+static void closeStream(TemplateStream& stream) {
+    stream.client.stop();   // Queued data still goes out before the FIN
+    stream.client = WiFiClient();
+    delete stream.reader;
+    stream.reader = nullptr;
+}
+
+// Writes what the send buffer takes until the slice is spent, closes the stream
+// once the page is complete or the client stops reading
+static void pumpStream(TemplateStream& stream, uint32_t sliceStart) {
+    uint8_t chunk[TEMPLATE_CHUNK_SIZE];
+    while (stream.client.connected() && micros() - sliceStart < TEMPLATE_PASS_BUDGET_US) {
+        size_t room = stream.client.availableForWrite();
+        if (room < TEMPLATE_MIN_ROOM) {
+            break;
+        }
+        size_t length = stream.reader->read(chunk, room < sizeof(chunk) ? room : sizeof(chunk));
+        if (length == 0) {
+            closeStream(stream);
+            return;
+        }
+        stream.client.write(chunk, length);
+        stream.lastWrite = millis();
+        sampleHeap();
+    }
+    if (!stream.client.connected() || millis() - stream.lastWrite > TEMPLATE_WRITE_TIMEOUT_MS) {
+        closeStream(stream);
+    }
+}
+
+void sendTemplate(int code, PGM_P page, const TemplateFiller& fill) {
+    uint32_t sliceStart = micros();
+    TemplateStream* stream = nullptr;
+    for (TemplateStream& candidate : templateStreams) {
+        if (!candidate.reader) {
+            stream = &candidate;
+            break;
+        }
+    }
+
+    if (!stream) {
+        // Every slot busy: render it inside the handler as before
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send(code, "text/html", "");
+        TemplateReader reader(page, fill);
+        char chunk[TEMPLATE_CHUNK_SIZE];
+        size_t length;
+        while ((length = reader.read((uint8_t*)chunk, sizeof(chunk))) > 0) {
+            sampleHeap();
+            server.sendContent(chunk, length);
+        }
+        server.sendContent("");     // End chunked response
+        return;
+    }
+
+    // Headers written directly, so the server doesn't frame or end the body
+    stream->client = server.client();
+    stream->client.setSync(false);
+    stream->client.printf("HTTP/1.1 %d %s\r\nContent-Type: text/html\r\nConnection: close\r\n\r\n",
+                          code, statusText(code));
+    stream->reader = new TemplateReader(page, fill);
+    stream->lastWrite = millis();
+    // Short pages are complete before the handler returns
+    pumpStream(*stream, sliceStart);
+}
+
+void handleTemplateStreams() {
+    for (TemplateStream& stream : templateStreams) {
+        if (stream.reader) {
+            pumpStream(stream, micros());
+        }
+    }
+}
+#endif
+
+void printHtmlEscaped(Print& out, const char* text) {
+    for (; *text; text++) {
+        switch (*text) {
+            case '&': out.print("&amp;"); break;
+            case '<': out.print("&lt;"); break;
+            case '>': out.print("&gt;"); break;
+            case '\'': out.print("&#39;"); break;
+            case '"': out.print("&quot;"); break;
+            default: out.write((uint8_t)*text); break;
+        }
+    }
+}
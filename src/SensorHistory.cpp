@@ -0,0 +1,222 @@
+#include "SensorHistory.h"
+#include "WiFiSetup.h"
+#include "TimeSync.h"
+#include "HeapStats.h"
+
+struct HistorySample {
+    int16_t temperature;
+    int16_t humidity;
+};
+
+// A sample's value is the base plus every delta up to it. Dropping the oldest
+// folds its delta into the base, so the ring never needs re-encoding.
+static HistorySample historyRing[HISTORY_SLOTS];
+static uint32_t historyTotal = 0;           // Samples stored since boot, the newest is historyTotal - 1
+static HistorySample historyBase = {0, 0};  // Value before the oldest sample still in the ring
+static HistorySample historyLast = {0, 0};  // Value after the newest
+static unsigned long historyMinuteStart = 0;
+
+static int32_t minuteTemperatureSum = 0;
+static int32_t minuteHumiditySum = 0;
+static uint16_t minuteReadings = 0;
+
+static void applyDelta(HistorySample& value, const HistorySample& delta) {
+    if (delta.temperature != HISTORY_GAP) {
+        value.temperature += delta.temperature;
+    }
+    if (delta.humidity != HISTORY_GAP) {
+        value.humidity += delta.humidity;
+    }
+}
+
+static int16_t toFixed(float value) {
+    return constrain(lroundf(value * HISTORY_SCALE), -HISTORY_LIMIT, HISTORY_LIMIT);
+}
+
+static int16_t average(int32_t sum, uint16_t count) {
+    return lroundf((float)sum / count);
+}
+
+static void pushSample() {
+    HistorySample& slot = historyRing[historyTotal % HISTORY_SLOTS];
+    if (historyTotal >= HISTORY_SLOTS) {
+        applyDelta(historyBase, slot);
+    }
+
+    if (minuteReadings > 0) {
+        HistorySample value = {average(minuteTemperatureSum, minuteReadings),
+                               average(minuteHumiditySum, minuteReadings)};
+        slot.temperature = value.temperature - historyLast.temperature;
+        slot.humidity = value.humidity - historyLast.humidity;
+        historyLast = value;
+    } else {
+        slot.temperature = HISTORY_GAP;
+        slot.humidity = HISTORY_GAP;
+    }
+    historyTotal++;
+
+    minuteTemperatureSum = 0;
+    minuteHumiditySum = 0;
+    minuteReadings = 0;
+}
+
+void recordHistoryReading(float celsius, float humidity) {
+    if (isnan(celsius) || isnan(humidity) || minuteReadings == UINT16_MAX) {
+        return;
+    }
+    minuteTemperatureSum += toFixed(celsius);
+    minuteHumiditySum += toFixed(humidity);
+    minuteReadings++;
+}
+
+void updateSensorHistory() {
+    unsigned long now = millis();
+    // A stalled loop leaves gaps, a day of them at most
+    for (uint16_t pushed = 0; now - historyMinuteStart >= HISTORY_INTERVAL_MS; pushed++) {
+        if (pushed == HISTORY_SLOTS) {
+            historyMinuteStart = now;
+            break;
+        }
+        pushSample();
+        historyMinuteStart += HISTORY_INTERVAL_MS;
+    }
+}
+
+// Produces the response a header or a sample at a time, copied out in whatever
+// pieces the server asks for. Reads the ring as it goes, nothing is buffered.
+class HistoryReader {
+public:
+    HistoryReader(bool binary, uint32_t count)
+        : _binary(binary), _headerSent(false), _end(historyTotal), _length(0), _offset(0) {
+        uint32_t stored = historyTotal < HISTORY_SLOTS ? historyTotal : HISTORY_SLOTS;
+        if (count > stored) {
+            count = stored;
+        }
+        _seq = _end - count;
+
+        _value = historyBase;
+        for (uint32_t seq = _end - stored; seq < _seq; seq++) {
+            applyDelta(_value, historyRing[seq % HISTORY_SLOTS]);
+        }
+
+        // End of the newest minute, Unix time or seconds before now
+        uint32_t age = (millis() - historyMinuteStart) / 1000;
+        _clockSet = isTimeSet();
+        _newestTime = _clockSet ? (uint32_t)time(nullptr) - age : age;
+    }
+
+    size_t read(uint8_t* buffer, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            if (_offset == _length && !next()) {
+                break;
+            }
+            size_t n = _length - _offset;
+            if (n > size - written) {
+                n = size - written;
+            }
+            memcpy(buffer + written, _piece + _offset, n);
+            _offset += n;
+            written += n;
+        }
+        return written;
+    }
+
+private:
+    // Formats the next piece, false at the end
+    bool next() {
+        _offset = 0;
+        if (!_headerSent) {
+            _headerSent = true;
+            _length = _binary ? binaryHeader() : snprintf(_piece, sizeof(_piece), "%s,temperature_c,humidity\n",
+                                                          _clockSet ? "time" : "age_s");
+            return true;
+        }
+        // Stop short rather than send a slot a new minute has overwritten
+        if (_seq == _end || historyTotal - _seq > HISTORY_SLOTS) {
+            _length = 0;
+            return false;
+        }
+
+        const HistorySample& delta = historyRing[_seq % HISTORY_SLOTS];
+        uint32_t minutesBack = _end - 1 - _seq;
+        _seq++;
+        if (_binary) {
+            memcpy(_piece, &delta, sizeof(delta));
+            _length = sizeof(delta);
+            return true;
+        }
+
+        applyDelta(_value, delta);
+        uint32_t when = _clockSet ? _newestTime - minutesBack * (HISTORY_INTERVAL_MS / 1000)
+                                  : _newestTime + minutesBack * (HISTORY_INTERVAL_MS / 1000);
+        _length = snprintf(_piece, sizeof(_piece), "%u,", (unsigned)when);
+        if (delta.temperature != HISTORY_GAP) {
+            _length += formatFixed(_piece + _length, _value.temperature);
+        }
+        _piece[_length++] = ',';
+        if (delta.humidity != HISTORY_GAP) {
+            _length += formatFixed(_piece + _length, _value.humidity);
+        }
+        _piece[_length++] = '\n';
+        return true;
+    }
+
+    uint8_t binaryHeader() {
+        uint16_t count = _end - _seq;
+        uint16_t interval = HISTORY_INTERVAL_MS / 1000;
+        uint32_t newest = _clockSet ? _newestTime : 0;
+        memcpy(_piece, "DCH1", 4);
+        memcpy(_piece + 4, &count, 2);
+        memcpy(_piece + 6, &interval, 2);
+        memcpy(_piece + 8, &newest, 4);
+        memcpy(_piece + 12, &_value, sizeof(_value));
+        return 16;
+    }
+
+    // Two decimals, HISTORY_SCALE is 100. At most 7 characters.
+    size_t formatFixed(char* out, int16_t value) {
+        unsigned magnitude = abs(value);
+        return snprintf(out, 8, "%s%u.%02u", value < 0 ? "-" : "", magnitude / HISTORY_SCALE, magnitude % HISTORY_SCALE);
+    }
+
+    bool _binary;
+    bool _headerSent;
+    bool _clockSet;
+    uint32_t _seq;
+    uint32_t _end;
+    uint32_t _newestTime;
+    HistorySample _value;       // Binary: before the first sample, CSV: the latest one sent
+    char _piece[32];            // "4294967295,-160.00,-160.00\n" is the longest
+    uint8_t _length;
+    uint8_t _offset;
+};
+
+void handleHistory() {
+    bool binary = server.arg("format") == "bin";
+    uint32_t count = HISTORY_SLOTS;
+    if (server.hasArg("minutes")) {
+        count = strtoul(server.arg("minutes").c_str(), nullptr, 10);
+    }
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, binary ? "application/octet-stream" : "text/csv", "");
+
+    HistoryReader reader(binary, count);
+#ifdef ASYNC_HTTP_SERVER
+    // Sent across loop passes as the client takes it
+    server.sendContentSource([reader](uint8_t* buffer, size_t size) mutable {
+        return reader.read(buffer, size);
+    });
+#else
+    char chunk[HISTORY_CHUNK_SIZE];
+    size_t length;
+    while ((length = reader.read((uint8_t*)chunk, sizeof(chunk))) > 0) {
+        sampleHeap();
+        server.sendContent(chunk, length);
+    }
+
+    // End chunked response
+    server.sendContent("");
+#endif
+}
@@ -0,0 +1,230 @@
+#include "TimeSync.h"
+#include "WiFiSetup.h"
+#include <coredecls.h>
+#include <sntp.h>
+#include <sys/time.h>
+
+time_t lastTimeSync = 0;  // Track last sync time
+
+static volatile bool timeValid = false;
+static TimeSyncEvent syncEvents[TIME_SYNC_HISTORY];
+static uint32_t syncCount = 0;
+
+// Free-running reference from the last sync, used to measure the correction of the next one
+static bool haveReference = false;
+static int64_t referenceUs = 0;        // Wall clock at the last sync
+static uint64_t referenceMicros = 0;   // micros64() at the last sync
+
+// Oscillator drift model, positive = our clock runs slow
+static float driftPpm = 0.0f;
+static float noisePpm = NTP_INITIAL_NOISE_PPM;  // Mean deviation of drift samples from the estimate
+static uint8_t driftSamples = 0;
+static uint32_t syncIntervalMs = NTP_MIN_SYNC_INTERVAL_MS;
+
+// Slew state since the last sync
+static int64_t slewSinceSyncUs = 0;
+static uint64_t lastSlewMicros = 0;
+static float slewRemainderUs = 0.0f;
+static uint8_t pendingSlewSets = 0;    // Our own settimeofday() calls still to come through the callback
+
+// lwIP SNTP (C code) asks for its polling interval through this weak hook.
+// It is read when the next poll is scheduled, so a new interval applies from the following sync.
+extern "C" uint32_t sntp_update_delay_MS_rfc_not_less_than_15000() {
+    return syncIntervalMs;
+}
+
+static uint32_t computeSyncInterval() {
+    if (driftSamples == 0) {
+        return NTP_MIN_SYNC_INTERVAL_MS;
+    }
+    // Error grows by noisePpm microseconds per second between syncs
+    float seconds = NTP_TARGET_ERROR_MS * 1000.0f / max(noisePpm, 0.01f);
+    float intervalMs = seconds * 1000.0f;
+    if (intervalMs < NTP_MIN_SYNC_INTERVAL_MS) return NTP_MIN_SYNC_INTERVAL_MS;
+    if (intervalMs > NTP_MAX_SYNC_INTERVAL_MS) return NTP_MAX_SYNC_INTERVAL_MS;
+    return (uint32_t)intervalMs;
+}
+
+static void updateDriftEstimate(float samplePpm) {
+    if (driftSamples == 0) {
+        driftPpm = samplePpm;
+    } else {
+        noisePpm += NTP_DRIFT_SMOOTHING * (fabsf(samplePpm - driftPpm) - noisePpm);
+        driftPpm += NTP_DRIFT_SMOOTHING * (samplePpm - driftPpm);
+    }
+    if (driftSamples < 255) {
+        driftSamples++;
+    }
+    syncIntervalMs = computeSyncInterval();
+}
+
+// The core runs settimeofday callbacks from its scheduler, so this is loop context
+static void onTimeSet(bool fromSntp) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    uint64_t nowMicros = micros64();
+    int64_t nowUs = (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+    timeValid = true;
+
+    if (!fromSntp) {
+        if (pendingSlewSets > 0) {
+            // One of our own drift corrections
+            pendingSlewSets--;
+            return;
+        }
+        // Manual set from the web page - not a sync, and the old reference is meaningless now
+        haveReference = false;
+        return;
+    }
+
+    TimeSyncEvent& event = syncEvents[syncCount % TIME_SYNC_HISTORY];
+    event.time = tv.tv_sec;
+    event.initial = !haveReference;
+    event.offset_ms = 0;
+    if (haveReference) {
+        int64_t elapsedUs = (int64_t)(nowMicros - referenceMicros);
+        int64_t expectedUs = referenceUs + elapsedUs + slewSinceSyncUs;
+        int64_t residualUs = nowUs - expectedUs;
+        event.offset_ms = (int32_t)(residualUs / 1000);
+
+        // Raw oscillator error is what NTP corrected plus what we already slewed
+        if (elapsedUs >= (int64_t)NTP_MIN_DRIFT_WINDOW_MS * 1000LL) {
+            updateDriftEstimate((float)(residualUs + slewSinceSyncUs) * 1e6f / (float)elapsedUs);
+        }
+    }
+    event.drift_ppm = driftPpm;
+    const char* server = sntp_getservername(0);
+    strlcpy(event.server, server ? server : "?", sizeof(event.server));
+    syncCount++;
+
+    haveReference = true;
+    referenceUs = nowUs;
+    referenceMicros = nowMicros;
+    lastTimeSync = tv.tv_sec;
+    slewSinceSyncUs = 0;
+    slewRemainderUs = 0.0f;
+    lastSlewMicros = nowMicros;
+
+    if (event.initial) {
+        printBothf("Time synchronized via NTP (%s)", event.server);
+    } else {
+        printBothf("NTP resync (%s), offset %ld ms, drift %.2f ppm, next in %lu min",
+                   event.server, (long)event.offset_ms, driftPpm, (unsigned long)(syncIntervalMs / 60000));
+    }
+}
+
+void handleTimeSync() {
+    if (!haveReference || driftSamples == 0) {
+        return;
+    }
+    uint64_t nowMicros = micros64();
+    if (nowMicros - lastSlewMicros < NTP_SLEW_INTERVAL_MS * 1000ULL) {
+        return;
+    }
+
+    // Carry sub-millisecond corrections over so that only whole steps touch the clock
+    slewRemainderUs += driftPpm * (float)(nowMicros - lastSlewMicros) / 1e6f;
+    lastSlewMicros = nowMicros;
+    if (fabsf(slewRemainderUs) < 1000.0f) {
+        return;
+    }
+    int32_t stepUs = (int32_t)slewRemainderUs;
+    slewRemainderUs -= stepUs;
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t correctedUs = (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec + stepUs;
+    tv.tv_sec = correctedUs / 1000000LL;
+    tv.tv_usec = correctedUs % 1000000LL;
+    pendingSlewSets++;
+    settimeofday(&tv, nullptr);
+    slewSinceSyncUs += stepUs;
+}
+
+void setupTime() {
+    // Load timezone configuration
+    loadTimeConfig();
+
+    settimeofday_cb(onTimeSet);
+    applyTimezone();
+}
+
+void applyTimezone() {
+    // Also restarts SNTP, which syncs right away
+    configTime(timeConfig.timezone_offset, 0, NTP_SERVER_1, NTP_SERVER_2);
+    printBothf("Setting up time with timezone %s (offset: %d seconds)", timeConfig.timezone_name, timeConfig.timezone_offset);
+}
+
+bool isTimeSet() {
+    return timeValid;
+}
+
+uint32_t getTimeSyncCount() {
+    return syncCount;
+}
+
+float getClockDriftPpm() {
+    return driftPpm;
+}
+
+uint32_t getNtpSyncIntervalMs() {
+    return syncIntervalMs;
+}
+
+const TimeSyncEvent* getTimeSyncEvent(uint8_t age) {
+    if (age >= TIME_SYNC_HISTORY || age >= syncCount) {
+        return nullptr;
+    }
+    return &syncEvents[(syncCount - 1 - age) % TIME_SYNC_HISTORY];
+}
+
+void printTimeSyncEvents(Print& out) {
+    out.printf("Clock %s, %lu syncs since boot\r\n", timeValid ? "set" : "not set", (unsigned long)syncCount);
+    out.printf("Drift %.2f ppm (noise %.2f ppm, %u samples), slewed %ld ms since sync, next sync in %lu min\r\n",
+               driftPpm, noisePpm, driftSamples, (long)(slewSinceSyncUs / 1000), (unsigned long)(syncIntervalMs / 60000));
+    for (uint8_t age = 0; age < TIME_SYNC_HISTORY; age++) {
+        const TimeSyncEvent* event = getTimeSyncEvent(age);
+        if (!event) {
+            break;
+        }
+        char when[24];
+        time_t local = event->time + timeConfig.timezone_offset;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&local));
+        if (event->initial) {
+            out.printf("  %s  %-16s initial\r\n", when, event->server);
+        } else {
+            out.printf("  %s  %-16s %+ld ms  %.2f ppm\r\n", when, event->server, (long)event->offset_ms, event->drift_ppm);
+        }
+    }
+}
+
+void handleTimeSyncStatus() {
+    DynamicJsonDocument doc(1024);
+    doc["time_set"] = (bool)timeValid;
+    doc["now"] = (uint32_t)time(nullptr);
+    doc["sync_count"] = syncCount;
+    doc["drift_ppm"] = driftPpm;
+    doc["noise_ppm"] = noisePpm;
+    doc["drift_samples"] = driftSamples;
+    doc["slew_ms"] = (int32_t)(slewSinceSyncUs / 1000);
+    doc["sync_interval_s"] = syncIntervalMs / 1000;
+
+    JsonArray events = doc.createNestedArray("syncs");
+    for (uint8_t age = 0; age < TIME_SYNC_HISTORY; age++) {
+        const TimeSyncEvent* event = getTimeSyncEvent(age);
+        if (!event) {
+            break;
+        }
+        JsonObject entry = events.createNestedObject();
+        entry["time"] = (uint32_t)event->time;
+        entry["server"] = event->server;
+        if (event->initial) {
+            entry["initial"] = true;
+        } else {
+            entry["offset_ms"] = event->offset_ms;
+            entry["drift_ppm"] = event->drift_ppm;
+        }
+    }
+
+    sendJsonResponse(200, doc);
+}
@@ -1,4 +1,19 @@
 #include "WiFiSetup.h"
+#include "BootProfiler.h"
+#include "Notifier.h"
+#include "TimeSync.h"
+#include "ConfigApi.h"
+#include "BufferedPrint.h"
+#include "PageTemplate.h"
+#include "LiveEvents.h"
+#include "HeapStats.h"
+#include "Metrics.h"
+#include "DeferredJobs.h"
+#include "OtaUpdate.h"
+#include "OtaUpload.h"
+#include "MqttOta.h"
+#include "SensorHistory.h"
+#include "WebAssets.h"
 #include <PubSubClient.h>
 #include <ESP8266mDNS.h>
 #include <ESP8266HTTPClient.h>
@@ -11,9 +26,19 @@ DisplayConfig displayConfig;
 DeviceConfig deviceConfig;  // Add DeviceConfig variable
 SystemCommandConfig systemCommandConfig; // Define the global SystemCommandConfig variable
 FirmwareConfig firmwareConfig;  // Add firmware config variable
+NotifyConfig notifyConfig;
 
 float version = 0.1f;
 
+// Flash write accounting for config files
+uint32_t configWritesCommitted = 0;
+uint32_t configWritesAvoided = 0;
+uint32_t mqttPublishes = 0;
+uint32_t mqttReconnects = 0;
+uint32_t mqttFailures = 0;
+static uint8_t pendingConfigSections = 0;       // ConfigSection bits waiting to be committed
+static unsigned long lastConfigChange = 0;      // millis() of the last markConfigDirty()
+
 // Declare the mqttCallback function
 void mqttCallback(char* topic, byte* payload, unsigned int length);
 
@@ -29,9 +54,8 @@ void handlePerformUpdate(); // Add forward declaration for handlePerformUpdate
 void handleSaveFirmwareURL(); // Add forward declaration for handleSaveFirmwareURL
 
 void displaySetupMessage(const char* message);
-void displaySetupMessageProgress(const char* progress);
 
-ESP8266WebServer server(80);
+WebServer server(80);
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
 
@@ -155,6 +179,11 @@ void resetWiFiSettings() {
             printBoth("Device configuration cleared");
         }
         
+        if (LittleFS.exists("/notify_config.json")) {
+            LittleFS.remove("/notify_config.json");
+            printBoth("Notify configuration cleared");
+        }
+        
         // Also remove any HTML template files that might have been created
         if (LittleFS.exists("/head.html")) {
             LittleFS.remove("/head.html");
@@ -202,12 +231,17 @@ void setDefaultSystemCommandConfig() {
 }
 
 void setDefaultFirmwareConfig() {
-    const char* defaultUrl = "https://arjunus1985.github.io/DeskClock/fwroot/firmware.bin";
+    // The gzipped image, the bootloader inflates it
+    const char* defaultUrl = "https://arjunus1985.github.io/DeskClock/fwroot/firmware.bin.gz";
     strncpy(firmwareConfig.update_url, defaultUrl, sizeof(firmwareConfig.update_url) - 1);
     firmwareConfig.update_url[sizeof(firmwareConfig.update_url) - 1] = '\0';
     printBothf("Set default firmware URL: %s", firmwareConfig.update_url);
 }
 
+void setDefaultNotifyConfig() {
+    notifyConfig = NotifyConfig();
+}
+
 void loadMQTTConfig() {
     if (!LittleFS.begin()) {
         printBoth("Failed to mount file system");
@@ -448,6 +482,7 @@ void loadFirmwareConfig() {
         return;
     }
 
+    firmwareConfig.auto_update = doc["auto_update"] | false;
     if (doc.containsKey("url")) {
         strlcpy(firmwareConfig.update_url, doc["url"], sizeof(firmwareConfig.update_url));
         if (strlen(firmwareConfig.update_url) == 0) {
@@ -458,6 +493,120 @@ void loadFirmwareConfig() {
     }
 }
 
+void loadNotifyConfig() {
+    if (!LittleFS.begin()) {
+        printBoth("Failed to mount file system");
+        setDefaultNotifyConfig();
+        return;
+    }
+
+    if (!LittleFS.exists("/notify_config.json")) {
+        setDefaultNotifyConfig();
+        return;
+    }
+
+    File configFile = LittleFS.open("/notify_config.json", "r");
+    if (!configFile) {
+        printBoth("Failed to open notify config file");
+        setDefaultNotifyConfig();
+        return;
+    }
+
+    StaticJsonDocument<256> doc;
+    DeserializationError error = deserializeJson(doc, configFile);
+    configFile.close();
+
+    if (error) {
+        printBoth("Failed to parse notify config file");
+        setDefaultNotifyConfig();
+        return;
+    }
+
+    strlcpy(notifyConfig.url, doc["url"] | "", sizeof(notifyConfig.url));
+}
+
+// Serialise doc and write it to path only if the bytes differ from the file on flash.
+// Returns true when the file was actually rewritten.
+static bool writeConfigFile(const char* path, const JsonDocument& doc) {
+    static char buf[600];  // Large enough for the 512 byte firmware URL
+    size_t len = measureJson(doc);
+    if (len >= sizeof(buf)) {
+        printBothf("Config %s too large to save", path);
+        return false;
+    }
+    serializeJson(doc, buf, sizeof(buf));
+
+    File existing = LittleFS.open(path, "r");
+    if (existing) {
+        bool same = (existing.size() == len);
+        uint8_t chunk[64];
+        size_t offset = 0;
+        while (same && offset < len) {
+            size_t want = len - offset;
+            if (want > sizeof(chunk)) want = sizeof(chunk);
+            size_t got = existing.read(chunk, want);
+            if (got == 0 || memcmp(chunk, buf + offset, got) != 0) {
+                same = false;
+            }
+            offset += got;
+        }
+        existing.close();
+
+        if (same) {
+            configWritesAvoided++;
+            printBothf("Config %s unchanged - flash write skipped", path);
+            return false;
+        }
+    }
+
+    File configFile = LittleFS.open(path, "w");
+    if (!configFile) {
+        printBothf("Failed to open %s for writing", path);
+        return false;
+    }
+    size_t written = configFile.write((const uint8_t*)buf, len);
+    configFile.close();
+
+    if (written != len) {
+        printBothf("Failed to write %s", path);
+        return false;
+    }
+    configWritesCommitted++;
+    return true;
+}
+
+void markConfigDirty(uint8_t sections) {
+    // A section that is already pending gets coalesced into the same commit
+    uint8_t coalesced = pendingConfigSections & sections;
+    while (coalesced) {
+        configWritesAvoided += coalesced & 1;
+        coalesced >>= 1;
+    }
+    pendingConfigSections |= sections;
+    lastConfigChange = millis();
+}
+
+void flushPendingConfig(bool force) {
+    if (pendingConfigSections == 0) {
+        return;
+    }
+    if (!force && millis() - lastConfigChange < CONFIG_SAVE_DEBOUNCE_MS) {
+        return;
+    }
+
+    uint8_t sections = pendingConfigSections;
+    pendingConfigSections = 0;
+
+    if (sections & CONFIG_MQTT) saveMQTTConfig();
+    if (sections & CONFIG_TIME) saveTimeConfig();
+    if (sections & CONFIG_DISPLAY) saveDisplayConfig();
+    if (sections & CONFIG_SYSTEM_COMMAND) saveSystemCommandConfig();
+    if (sections & CONFIG_FIRMWARE) saveFirmwareConfig();
+    if (sections & CONFIG_NOTIFY) saveNotifyConfig();
+    // Device config goes last since a hostname change restarts the clock
+    if (sections & CONFIG_DEVICE) saveDeviceConfig();
+}
+
 void saveFirmwareConfig() {
     if (!LittleFS.begin()) {
         printBoth("Failed to mount file system");
@@ -466,19 +615,25 @@ void saveFirmwareConfig() {
 
     StaticJsonDocument<512> doc;
     doc["url"] = firmwareConfig.update_url;
+    doc["auto_update"] = firmwareConfig.auto_update;
 
-    File file = LittleFS.open("/firmware_config.json", "w");
-    if (!file) {
-        printBoth("Failed to open firmware config file for writing");
+    if (writeConfigFile("/firmware_config.json", doc)) {
+        printBoth("Firmware config saved successfully");
+    }
+}
+
+void saveNotifyConfig() {
+    if (!LittleFS.begin()) {
+        printBoth("Failed to mount file system");
         return;
     }
 
-    if (serializeJson(doc, file) == 0) {
-        printBoth("Failed to write firmware config file");
-    } else {
-        printBoth("Firmware config saved successfully");
+    StaticJsonDocument<256> doc;
+    doc["url"] = notifyConfig.url;
+
+    if (writeConfigFile("/notify_config.json", doc)) {
+        printBoth("Notify config saved");
     }
-    file.close();
 }
 
 void saveMQTTConfig() {
@@ -493,16 +648,7 @@ void saveMQTTConfig() {
     doc["user"] = mqttConfig.mqtt_user;
     doc["password"] = mqttConfig.mqtt_password;
 
-    File configFile = LittleFS.open("/mqtt_config.json", "w");
-    if (!configFile) {
-        printBoth("Failed to open config file for writing");
-        return;
-    }
-
-    if (serializeJson(doc, configFile) == 0) {
-        printBoth("Failed to write config file");
-    }
-    configFile.close();
+    writeConfigFile("/mqtt_config.json", doc);
 }
 
 void saveTimeConfig() {
@@ -515,17 +661,7 @@ void saveTimeConfig() {
     doc["timezone_offset"] = timeConfig.timezone_offset;
     doc["timezone_name"] = timeConfig.timezone_name;
 
-    File configFile = LittleFS.open("/time_config.json", "w");
-    if (!configFile) {
-        printBoth("Failed to open time config file for writing");
-        return;
-    }
-
-    if (serializeJson(doc, configFile) == 0) {
-        printBoth("Failed to write time config file");
-    }
-    configFile.close();
-  
+    writeConfigFile("/time_config.json", doc);
 }
 
 void saveDisplayConfig() {
@@ -547,18 +683,9 @@ void saveDisplayConfig() {
     doc["temp_delta"] = displayConfig.temp_delta;
     doc["humidity_delta"] = displayConfig.humidity_delta;
 
-    File configFile = LittleFS.open("/display_config.json", "w");
-    if (!configFile) {
-        printBoth("Failed to open display config file for writing");
-        return;
+    if (writeConfigFile("/display_config.json", doc)) {
+        printBoth("Display config saved");
     }
-
-    if (serializeJson(doc, configFile) == 0) {
-        printBoth("Failed to write display config file");
-    }
-    configFile.close();
-    
-    printBoth("Display config saved");
 }
 
 void saveDeviceConfig() {
@@ -570,17 +697,10 @@ void saveDeviceConfig() {
     StaticJsonDocument<200> doc;
     doc["hostname"] = deviceConfig.hostname;
 
-    File configFile = LittleFS.open("/device_config.json", "w");
-    if (!configFile) {
-        printBoth("Failed to open device config file for writing");
-        return;
+    if (!writeConfigFile("/device_config.json", doc)) {
+        return;  // Hostname unchanged, no need to restart
     }
 
-    if (serializeJson(doc, configFile) == 0) {
-        printBoth("Failed to write device config file");
-    }
-    configFile.close();
-    
     printBothf("Device config saved - hostname: %s", deviceConfig.hostname);
     //restart esp 
     ESP.restart();
@@ -595,247 +715,182 @@ void saveSystemCommandConfig() {
     StaticJsonDocument<200> doc;
     doc["command"] = systemCommandConfig.command;
 
-    File configFile = LittleFS.open("/system_command.json", "w");
-    if (!configFile) {
-        printBoth("Failed to open system command config file for writing");
-        return;
+    if (writeConfigFile("/system_command.json", doc)) {
+        printBoth("System command config saved");
     }
+}
 
-    if (serializeJson(doc, configFile) == 0) {
-        printBoth("Failed to write system command config file");
-    }
-    configFile.close();
-    
-    printBoth("System command config saved");
+// Configuration page, CSS and scripts are gzipped PROGMEM assets from WebAssets.h that the browser caches
+static const char ROOT_PAGE[] PROGMEM = R"(<!DOCTYPE html>
+<html>
+<head>
+<meta name='viewport' content='width=device-width, initial-scale=1.0'>
+<link rel='stylesheet' href='/style.css'>
+<script src='/config.js' defer></script>
+</head>
+<body>
+<h1>Device Configuration</h1>
+<div class='status'>
+<p><strong>IP Address:</strong> {{ip}}</p>
+<p><strong>MAC Address:</strong> {{mac}}</p>
+<p id='live'><strong>Now:</strong> <span id='live_time'>--</span>,
+<span id='live_temperature'>--</span>&deg;, <span id='live_humidity'>--</span>%,
+intensity <span id='live_intensity'>--</span>, showing <span id='live_display'>--</span></p>
+</div>
+<form action='/save' method='POST'>
+<h2>Device Settings</h2>
+<div class='form-group'>
+<label for='hostname'>Hostname:</label>
+<input type='text' id='hostname' name='hostname' value='{{hostname}}' maxlength='31'>
+<small style='display: block; margin-top: 5px; color: #666;'>The hostname is used to identify this device on your network (used for MQTT and OTA)</small>
+</div>
+<input type='submit' value='Save Device Settings'>
+</form>
+<form action='/save' method='POST'>
+<h2>Display Settings</h2>
+<input type='hidden' name='display_form' value='1'>
+<div class='form-group'>
+<label>Time Format:</label><br>
+<input type='radio' id='format_ampm' name='time_format' value='ampm' {{ampm_checked}}>
+<label for='format_ampm'>AM/PM</label>
+<input type='radio' id='24h' name='time_format' value='24h' {{24h_checked}}>
+<label for='24h'>24-hour</label>
+</div>
+<div class='form-group'>
+<label>Brightness Control:</label><br>
+<input type='checkbox' id='auto_brightness' name='auto_brightness' value='1' {{auto_brightness_checked}}>
+<label for='auto_brightness'>Enable Auto Brightness</label><br>
+<div id='brightness_range' style='margin-left: 20px; margin-top: 10px;'>
+<label for='min_brightness'>Min Brightness (0-15):</label>
+<input type='number' id='min_brightness' name='min_brightness' min='0' max='15' value='{{min_brightness}}'>
+<label for='max_brightness'>Max Brightness (0-15):</label>
+<input type='number' id='max_brightness' name='max_brightness' min='0' max='15' value='{{max_brightness}}'>
+</div>
+<div id='manual_brightness' style='margin-left: 20px; margin-top: 10px;'>
+<label for='man_brightness'>Manual Brightness (0-15):</label>
+<input type='number' id='man_brightness' name='man_brightness' min='0' max='15' value='{{man_brightness}}' {{man_brightness_disabled}}>
+</div>
+</div>
+<div class='form-group'>
+<label for='temp_delta'>Temperature Adjustment (C):</label>
+<input type='number' id='temp_delta' name='temp_delta' step='0.1' value='{{temp_delta}}'>
+<small style='display: block; margin-top: 5px; color: #666;'>Adjust the temperature reading by this value (e.g., -2.5 or 1.0)</small>
+</div>
+<input type='submit' value='Save Display Settings'>
+</form>
+<form action='/save' method='POST'>
+<h2>MQTT Settings</h2>
+<div class='form-group'>
+<label for='mqtt_server'>Server:</label>
+<input type='text' id='mqtt_server' name='mqtt_server' value='{{mqtt_server}}'>
+</div>
+<div class='form-group'>
+<label for='mqtt_port'>Port:</label>
+<input type='number' id='mqtt_port' name='mqtt_port' value='{{mqtt_port}}'>
+</div>
+<div class='form-group'>
+<label for='mqtt_user'>Username:</label>
+<input type='text' id='mqtt_user' name='mqtt_user' value='{{mqtt_user}}'>
+</div>
+<div class='form-group'>
+<label for='mqtt_password'>Password:</label>
+<input type='password' id='mqtt_password' name='mqtt_password' value='{{mqtt_password}}'>
+</div>
+<input type='submit' value='Save MQTT Settings'>
+</form>
+<form action='/settime' method='POST'>
+<h2>Set Date and Time</h2>
+<div class='form-group'>
+<label for='datetime'>Date and Time:</label>
+<input type='datetime-local' id='datetime' name='datetime' required>
+</div>
+<input type='submit' value='Set Date and Time'>
+</form>
+<form action='/save' method='POST'>
+<h2>Display Durations</h2>
+<div class='form-group'>
+<label for='date_duration'>Date Duration (seconds):</label>
+<input type='number' id='date_duration' name='date_duration' min='0' max='60' value='{{date_duration}}'>
+<small style='display: block; margin-top: 5px; color: #666;'>Set to 0 to disable date display</small>
+</div>
+<div class='form-group'>
+<label for='temp_duration'>Temperature Duration (seconds):</label>
+<input type='number' id='temp_duration' name='temp_duration' min='0' max='60' value='{{temp_duration}}'>
+<small style='display: block; margin-top: 5px; color: #666;'>Set to 0 to disable temperature display</small>
+</div>
+<div class='form-group'>
+<label for='humidity_duration'>Humidity Duration (seconds):</label>
+<input type='number' id='humidity_duration' name='humidity_duration' min='0' max='60' value='{{humidity_duration}}'>
+<small style='display: block; margin-top: 5px; color: #666;'>Set to 0 to disable humidity display</small>
+</div>
+<input type='submit' value='Save Durations'>
+</form>
+<br/><a href='/system' >System Administration</a>
+<div class='footer'>
+<p>Designed by: Arjun Bhattacharjee (mymail.arjun@gmail.com)</p>
+</div>
+</body>
+</html>)";
+
+static void fillRootPage(Print& out, const char* name) {
+    if (strcmp(name, "ip") == 0) out.print(WiFi.localIP());
+    else if (strcmp(name, "mac") == 0) out.print(WiFi.macAddress());
+    else if (strcmp(name, "hostname") == 0) printHtmlEscaped(out, deviceConfig.hostname);
+    else if (strcmp(name, "ampm_checked") == 0) out.print(!displayConfig.use_24h_format ? "checked" : "");
+    else if (strcmp(name, "24h_checked") == 0) out.print(displayConfig.use_24h_format ? "checked" : "");
+    else if (strcmp(name, "auto_brightness_checked") == 0) out.print(displayConfig.auto_brightness ? "checked" : "");
+    else if (strcmp(name, "min_brightness") == 0) out.print(displayConfig.min_brightness);
+    else if (strcmp(name, "max_brightness") == 0) out.print(displayConfig.max_brightness);
+    else if (strcmp(name, "man_brightness") == 0) out.print(displayConfig.man_brightness);
+    else if (strcmp(name, "man_brightness_disabled") == 0) out.print(displayConfig.auto_brightness ? "disabled" : "");
+    else if (strcmp(name, "temp_delta") == 0) out.print(displayConfig.temp_delta);
+    else if (strcmp(name, "mqtt_server") == 0) printHtmlEscaped(out, mqttConfig.mqtt_server);
+    else if (strcmp(name, "mqtt_port") == 0) out.print(mqttConfig.mqtt_port);
+    else if (strcmp(name, "mqtt_user") == 0) printHtmlEscaped(out, mqttConfig.mqtt_user);
+    else if (strcmp(name, "mqtt_password") == 0) printHtmlEscaped(out, mqttConfig.mqtt_password);
+    else if (strcmp(name, "date_duration") == 0) out.print(displayConfig.date_duration);
+    else if (strcmp(name, "temp_duration") == 0) out.print(displayConfig.temp_duration);
+    else if (strcmp(name, "humidity_duration") == 0) out.print(displayConfig.humidity_duration);
 }
 
 void handleRoot() {
     // Add this debug message before generating the page
     printBothf("Loading config page - auto_brightness is currently: %s", displayConfig.auto_brightness ? "ON" : "OFF");
-    
-    // Start chunked response
-    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
-    server.send(200, "text/html", "");
-    
-    // Send HTML in chunks
-    server.sendContent(
-        "<!DOCTYPE html>"
-        "<html>"
-        "<head>"
-        "<meta name='viewport' content='width=device-width, initial-scale=1.0'>"
-        "<style>"
-    );
-
-    // Send CSS chunk
-    server.sendContent(
-        "body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }"
-        "h1, h2 { color: #333; }"
-        "form { background: #f5f5f5; padding: 20px; border-radius: 8px; margin: 15px 0; }"
-        ".form-group { margin-bottom: 15px; }"
-        "label { display: block; margin-bottom: 5px; }"
-        "input[type='text'], input[type='number'], input[type='password'] { width: 100%; padding: 8px; font-size: 16px; border: 1px solid #ddd; border-radius: 4px; box-sizing: border-box; }"
-        "input[type='submit'], input[type='button'] { background: #007bff; color: white; border: none; padding: 10px 20px; font-size: 16px; border-radius: 4px; cursor: pointer; width: 100%; margin-bottom: 10px; }"
-        "input[type='submit']:hover, input[type='button']:hover { background: #0056b3; }"
-        ".status { background: #e8f4fd; padding: 10px; border-radius: 4px; margin-bottom: 20px; }"
-        ".system-btn { display: block; background: #28a745; color: white; border: none; padding: 12px 20px; font-size: 16px; border-radius: 4px; cursor: pointer; width: 100%; margin: 20px 0; text-align: center; text-decoration: none; }"
-        ".system-btn:hover { background: #218838; }"
-        ".footer { margin-top: 30px; padding: 20px; background: #f8f9fa; border-radius: 4px; text-align: center; }"
-        ".footer p { margin: 5px 0; color: #666; }"
-    );
-
-    // Send script chunk
-    server.sendContent(
-        "</style>"
-        "<script>"
-        "function setCurrentDateTime() {"
-        "const now = new Date();"
-        "document.getElementById('year').value = now.getFullYear();"
-        "document.getElementById('month').value = now.getMonth() + 1;"
-        "document.getElementById('day').value = now.getDate();"
-        "let hours = now.getHours();"
-        "const ampm = hours >= 12 ? 'P' : 'A';"
-        "hours = hours % 12;"
-        "hours = hours ? hours : 12;"
-        "document.getElementById('hour').value = hours;"
-        "document.getElementById('minute').value = now.getMinutes();"
-        "const ampmSelect = document.getElementById('ampm');"
-        "for(let i = 0; i < ampmSelect.options.length; i++) {"
-        "if(ampmSelect.options[i].value === ampm) {"
-        "ampmSelect.selectedIndex = i;"
-        "break;"
-        "}"
-        "}"
-        "}"
-
-        "document.addEventListener('DOMContentLoaded', function() {"
-        "  const autoBrightnessCheckbox = document.getElementById('auto_brightness');"
-        "  const minBrightnessInput = document.getElementById('min_brightness');"
-        "  const maxBrightnessInput = document.getElementById('max_brightness');"
-        "  const manualBrightnessInput = document.getElementById('man_brightness');"
-        "  function toggleBrightnessInputs() {"
-        "    const autoEnabled = autoBrightnessCheckbox.checked;"
-        "    minBrightnessInput.disabled = !autoEnabled;"
-        "    maxBrightnessInput.disabled = !autoEnabled;"
-        "    manualBrightnessInput.disabled = autoEnabled;"
-        "  }"
-        "  autoBrightnessCheckbox.addEventListener('change', toggleBrightnessInputs);"
-        "  toggleBrightnessInputs(); "
-        "});"
-
-        "</script>"
-        "</head>"
-        "<body>"
-        "<h1>Device Configuration</h1>"
-    );
-
-    // Send device status chunk with both IP and MAC address, with improved styling
-    String macAddress = WiFi.macAddress();
-    String statusChunk = "<div class='status'>"
-        "<p><strong>IP Address:</strong> " + WiFi.localIP().toString() + "</p>"
-        "<p><strong>MAC Address:</strong> " + macAddress + "</p>"
-        "</div>";
-    server.sendContent(statusChunk);
-
-    // Send device settings form
-    String deviceSettingsChunk = 
-        "<form action='/save' method='POST'>"
-        "<h2>Device Settings</h2>"
-        "<div class='form-group'>"
-        "<label for='hostname'>Hostname:</label>"
-        "<input type='text' id='hostname' name='hostname' value='" + String(deviceConfig.hostname) + "' maxlength='31'>"
-        "<small style='display: block; margin-top: 5px; color: #666;'>The hostname is used to identify this device on your network (used for MQTT and OTA)</small>"
-        "</div>"
-        "<input type='submit' value='Save Device Settings'>"
-        "</form>";
-    server.sendContent(deviceSettingsChunk);
-
-    // Send display settings form
-    String displaySettingsChunk = 
-        "<form action='/save' method='POST'>"
-        "<h2>Display Settings</h2>"
-        "<div class='form-group'>"
-        "<label>Time Format:</label><br>"
-        "<input type='radio' id='format_ampm' name='time_format' value='ampm' " + String(!displayConfig.use_24h_format ? "checked" : "") + ">"
-        "<label for='format_ampm'>AM/PM</label>"
-        "<input type='radio' id='24h' name='time_format' value='24h' " + String(displayConfig.use_24h_format ? "checked" : "") + ">"
-        "<label for='24h'>24-hour</label>"
-        "</div>";
-    server.sendContent(displaySettingsChunk);
-
-    // Add brightness settings with min, max, and manual brightness inputs
-    String brightnessChunk =
-        "<div class='form-group'>"
-        "<label>Brightness Control:</label><br>"
-        "<input type='checkbox' id='auto_brightness' name='auto_brightness' value='1' " + String(displayConfig.auto_brightness ? "checked" : "") + ">"
-        "<label for='auto_brightness'>Enable Auto Brightness</label><br>"
-        "<div id='brightness_range' style='margin-left: 20px; margin-top: 10px;'>"
-        "<label for='min_brightness'>Min Brightness (0-15):</label>"
-        "<input type='number' id='min_brightness' name='min_brightness' min='0' max='15' value='" + String(displayConfig.min_brightness) + "'>"
-        "<label for='max_brightness'>Max Brightness (0-15):</label>"
-        "<input type='number' id='max_brightness' name='max_brightness' min='0' max='15' value='" + String(displayConfig.max_brightness) + "'>"
-        "</div>"
-        "<div id='manual_brightness' style='margin-left: 20px; margin-top: 10px;'>"
-        "<label for='man_brightness'>Manual Brightness (0-15):</label>"
-        "<input type='number' id='man_brightness' name='man_brightness' min='0' max='15' value='" + String(displayConfig.man_brightness) + "' " + String(displayConfig.auto_brightness ? "disabled" : "") + ">"
-        "</div>"
-        "</div>";
-    server.sendContent(brightnessChunk);
- // Consolidate and fix JavaScript for toggling brightness inputs
-
-    // Add a field for temp_delta and remove the repeated Reset Configuration section
-    String tempDeltaField =
-        "<div class='form-group'>"
-        "<label for='temp_delta'>Temperature Adjustment (C):</label>"
-        "<input type='number' id='temp_delta' name='temp_delta' step='0.1' value='" + String(displayConfig.temp_delta) + "'>"
-        "<small style='display: block; margin-top: 5px; color: #666;'>Adjust the temperature reading by this value (e.g., -2.5 or 1.0)</small>"
-        "</div>";
-    server.sendContent(tempDeltaField);
-
-    String displaySettingsChunk2 = 
-        "<input type='submit' value='Save Display Settings'>"
-        "</form>";
-    server.sendContent(displaySettingsChunk2);
-
-    // Send MQTT settings form
-    String mqttChunk =
-        "<form action='/save' method='POST'>"
-        "<h2>MQTT Settings</h2>"
-        "<div class='form-group'>"
-        "<label for='mqtt_server'>Server:</label>"
-        "<input type='text' id='mqtt_server' name='mqtt_server' value='" + String(mqttConfig.mqtt_server) + "'>"
-        "</div>"
-        "<div class='form-group'>"
-        "<label for='mqtt_port'>Port:</label>"
-        "<input type='number' id='mqtt_port' name='mqtt_port' value='" + String(mqttConfig.mqtt_port) + "'>"
-        "</div>"
-        "<div class='form-group'>"
-        "<label for='mqtt_user'>Username:</label>"
-        "<input type='text' id='mqtt_user' name='mqtt_user' value='" + String(mqttConfig.mqtt_user) + "'>"
-        "</div>"
-        "<div class='form-group'>"
-        "<label for='mqtt_password'>Password:</label>"
-        "<input type='password' id='mqtt_password' name='mqtt_password' value='" + String(mqttConfig.mqtt_password) + "'>"
-        "</div>"
-        "<input type='submit' value='Save MQTT Settings'>"
-        "</form>";
-    server.sendContent(mqttChunk);
-
-    // Add a modern calendar control for manual date and time capture
-    String dateTimeForm =
-        "<form action='/settime' method='POST'>"
-        "<h2>Set Date and Time</h2>"
-        "<div class='form-group'>"
-        "<label for='datetime'>Date and Time:</label>"
-        "<input type='datetime-local' id='datetime' name='datetime' required>"
-        "</div>"
-        "<input type='submit' value='Set Date and Time'>"
-        "</form>"
-        "<script>"
-        "document.addEventListener('DOMContentLoaded', function() {"
-        "  const now = new Date();"
-        "  const localDateTime = new Date(now.getTime() - now.getTimezoneOffset() * 60000).toISOString().slice(0, 16);"
-        "  document.getElementById('datetime').value = localDateTime;"
-        "});"
-        "</script>";
-    server.sendContent(dateTimeForm);
-
-    // Add fields for date_duration, temp_duration, and humidity_duration to the config page
-    String durationFields =
-        "<form action='/save' method='POST'>"
-        "<h2>Display Durations</h2>"
-        "<div class='form-group'>"
-        "<label for='date_duration'>Date Duration (seconds):</label>"
-        "<input type='number' id='date_duration' name='date_duration' min='0' max='60' value='" + String(displayConfig.date_duration) + "'>"
-        "<small style='display: block; margin-top: 5px; color: #666;'>Set to 0 to disable date display</small>"
-        "</div>"
-        "<div class='form-group'>"
-        "<label for='temp_duration'>Temperature Duration (seconds):</label>"
-        "<input type='number' id='temp_duration' name='temp_duration' min='0' max='60' value='" + String(displayConfig.temp_duration) + "'>"
-        "<small style='display: block; margin-top: 5px; color: #666;'>Set to 0 to disable temperature display</small>"
-        "</div>"
-        "<div class='form-group'>"
-        "<label for='humidity_duration'>Humidity Duration (seconds):</label>"
-        "<input type='number' id='humidity_duration' name='humidity_duration' min='0' max='60' value='" + String(displayConfig.humidity_duration) + "'>"
-        "<small style='display: block; margin-top: 5px; color: #666;'>Set to 0 to disable humidity display</small>"
-        "</div>"
-        "<input type='submit' value='Save Durations'>"
-        "</form>";
-    server.sendContent(durationFields);
-
-    // Send footer and closing tags
-    String footerChunk =
-        "<br/><a href='/system' >System Administration</a>"
-        "<div class='footer'>"
-        "<p>Designed by: Arjun Bhattacharjee (mymail.arjun@gmail.com)</p>"
-        "</div>"
-        "</body>"
-        "</html>";
-    server.sendContent(footerChunk);
-
-   
-
-    // End chunked response
-    server.sendContent("");
+
+    sendTemplate(200, ROOT_PAGE, fillRootPage);
+}
+
+// Result page shared by the form handlers
+static const char MESSAGE_PAGE[] PROGMEM = R"(<!DOCTYPE html>
+<html>
+<head>
+    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
+    <style>
+        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
+        h1 { color: #333; }
+        .status { background: #e8fff4; padding: 10px; border-radius: 4px; margin: 20px 0; color: #28a745; }
+        .status.error { background: #ffe6e6; color: #dc3545; }
+        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
+               text-decoration: none; border-radius: 4px; margin-top: 20px; }
+        .btn:hover { background: #0056b3; }
+    </style>
+</head>
+<body>
+    <h1>{{title}}</h1>
+    <div class='status{{status_class}}'>{{message}}</div>
+    {{back}}
+</body>
+</html>)";
+
+// backUrl may be nullptr for pages that have nowhere to go back to. The page can
+// be rendered after the handler returns, so the strings must be literals.
+static void sendMessagePage(int code, const char* title, const char* message, const char* backUrl) {
+    sendTemplate(code, MESSAGE_PAGE, [=](Print& out, const char* name) {
+        if (strcmp(name, "title") == 0) out.print(title);
+        else if (strcmp(name, "status_class") == 0) out.print(code >= 400 ? " error" : "");
+        else if (strcmp(name, "message") == 0) out.print(message);
+        else if (strcmp(name, "back") == 0 && backUrl) out.printf("<a href='%s' class='btn'>Go Back</a>", backUrl);
+    });
 }
 
 void handleSave() {
@@ -848,80 +903,74 @@ void handleSave() {
     if (server.hasArg("hostname")) {
         // Make sure the hostname isn't empty and doesn't exceed limit
         String hostname = server.arg("hostname");
-        if (hostname.length() > 0) {
-            strncpy(deviceConfig.hostname, hostname.c_str(), sizeof(deviceConfig.hostname) - 1);
+        if (hostname.length() > 0 &&
+            updateField(deviceConfig.hostname, sizeof(deviceConfig.hostname), hostname.c_str())) {
             deviceChanged = true;
             printBothf("Hostname changed to: %s", deviceConfig.hostname);
         }
     }
     
     if (deviceChanged) {
-        saveDeviceConfig();
+        markConfigDirty(CONFIG_DEVICE);
         configChanged = true;
     }
     
     // Handle display settings
     if (server.hasArg("time_format")) {
-        displayConfig.use_24h_format = (server.arg("time_format") == "24h");
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.use_24h_format, server.arg("time_format") == "24h");
     }
     
     // Handle sensor calibration values
     if (server.hasArg("temp_delta")) {
-        displayConfig.temp_delta = constrain(server.arg("temp_delta").toFloat(), -10.0, 10.0);
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.temp_delta, constrain(server.arg("temp_delta").toFloat(), -10.0, 10.0));
     }
     if (server.hasArg("humidity_delta")) {
-        displayConfig.humidity_delta = constrain(server.arg("humidity_delta").toFloat(), -20.0, 20.0);
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.humidity_delta, constrain(server.arg("humidity_delta").toFloat(), -20.0, 20.0));
     }
     
     if (server.hasArg("temp_format")) {
-        displayConfig.use_celsius = (server.arg("temp_format") == "C");
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.use_celsius, server.arg("temp_format") == "C");
     }
     if (server.hasArg("date_duration")) {
-        displayConfig.date_duration = constrain(server.arg("date_duration").toInt(), 0, 60);
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.date_duration, constrain(server.arg("date_duration").toInt(), 0, 60));
     }
     if (server.hasArg("temp_duration")) {
-        displayConfig.temp_duration = constrain(server.arg("temp_duration").toInt(), 0, 60);
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.temp_duration, constrain(server.arg("temp_duration").toInt(), 0, 60));
     }
     if (server.hasArg("humidity_duration")) {
-        displayConfig.humidity_duration = constrain(server.arg("humidity_duration").toInt(), 0, 60);
-        displayChanged = true;
+        displayChanged |= updateField(displayConfig.humidity_duration, constrain(server.arg("humidity_duration").toInt(), 0, 60));
     }
     
-    // Explicitly set auto_brightness based on presence of argument
-    // For checkboxes, the parameter is only sent when checked
-    displayConfig.auto_brightness = server.hasArg("auto_brightness");
-    displayChanged = true;
+    // For checkboxes, the parameter is only sent when checked, so only trust its
+    // absence when the post came from the display settings form
+    if (server.hasArg("display_form")) {
+        displayChanged |= updateField(displayConfig.auto_brightness, server.hasArg("auto_brightness"));
+    }
     
     if (displayConfig.auto_brightness) {
         if (server.hasArg("min_brightness") && server.hasArg("max_brightness")) {
             int minBrightness = constrain(server.arg("min_brightness").toInt(), 0, 15);
             int maxBrightness = constrain(server.arg("max_brightness").toInt(), 0, 15);
-            if (minBrightness <= maxBrightness) {
-                displayConfig.min_brightness = minBrightness;
-                displayConfig.max_brightness = maxBrightness;
-            } else {
+            if (minBrightness > maxBrightness) {
                 // If min > max, swap them
-                displayConfig.min_brightness = maxBrightness;
-                displayConfig.max_brightness = minBrightness;
+                int swap = minBrightness;
+                minBrightness = maxBrightness;
+                maxBrightness = swap;
             }
+            displayChanged |= updateField(displayConfig.min_brightness, minBrightness);
+            displayChanged |= updateField(displayConfig.max_brightness, maxBrightness);
         }
     } else {
         if (server.hasArg("manual_brightness_value")) {
-            displayConfig.man_brightness = constrain(server.arg("manual_brightness_value").toInt(), 0, 15);
+            displayChanged |= updateField(displayConfig.man_brightness, constrain(server.arg("manual_brightness_value").toInt(), 0, 15));
         }
     }
     
     if (displayChanged) {
-        saveDisplayConfig();
+        markConfigDirty(CONFIG_DISPLAY);
         
         configChanged = true;
-        printBoth("Display settings saved");
+        printBoth("Display settings changed");
         printBothf("Auto brightness: %s, Min: %d, Max: %d, Manual: %d", 
                   displayConfig.auto_brightness ? "ON" : "OFF",
                   displayConfig.min_brightness, 
@@ -936,99 +985,60 @@ void handleSave() {
         String timezone = server.arg("timezone");
         int commaIndex = timezone.indexOf(',');
         if (commaIndex > 0) {
-            timeConfig.timezone_offset = timezone.substring(0, commaIndex).toInt();
-            strncpy(timeConfig.timezone_name, 
-                   timezone.substring(commaIndex + 1).c_str(), 
-                   sizeof(timeConfig.timezone_name) - 1);
-            saveTimeConfig();
-            configChanged = true;
+            bool timeChanged = updateField(timeConfig.timezone_offset, timezone.substring(0, commaIndex).toInt());
+            timeChanged |= updateField(timeConfig.timezone_name, sizeof(timeConfig.timezone_name),
+                                       timezone.substring(commaIndex + 1).c_str());
+            if (timeChanged) {
+                markConfigDirty(CONFIG_TIME);
+                configChanged = true;
+                deferJob(applyTimezone);
+            }
         }
     }
 
     // Handle MQTT settings
     if (server.hasArg("mqtt_server")) {
-        strncpy(mqttConfig.mqtt_server, server.arg("mqtt_server").c_str(), 40);
-        mqttChanged = true;
+        mqttChanged |= updateField(mqttConfig.mqtt_server, sizeof(mqttConfig.mqtt_server), server.arg("mqtt_server").c_str());
     }
     if (server.hasArg("mqtt_port")) {
-        mqttConfig.mqtt_port = server.arg("mqtt_port").toInt();
-        mqttChanged = true;
+        mqttChanged |= updateField(mqttConfig.mqtt_port, server.arg("mqtt_port").toInt());
     }
     if (server.hasArg("mqtt_user")) {
-        strncpy(mqttConfig.mqtt_user, server.arg("mqtt_user").c_str(), 32);
-        mqttChanged = true;
+        mqttChanged |= updateField(mqttConfig.mqtt_user, sizeof(mqttConfig.mqtt_user), server.arg("mqtt_user").c_str());
     }
     if (server.hasArg("mqtt_password")) {
-        strncpy(mqttConfig.mqtt_password, server.arg("mqtt_password").c_str(), 32);
-        mqttChanged = true;
+        mqttChanged |= updateField(mqttConfig.mqtt_password, sizeof(mqttConfig.mqtt_password), server.arg("mqtt_password").c_str());
     }
 
     if (mqttChanged) {
-        saveMQTTConfig();
+        markConfigDirty(CONFIG_MQTT);
         configChanged = true;
-        printBoth("MQTT settings saved");
-        // Force MQTT reconnection with new settings
-        if (mqttClient.connected()) {
-            mqttClient.disconnect();
-        }
-        setupMQTT();
+        printBoth("MQTT settings changed");
+        // The broker connect can take seconds, so it waits until the page is out
+        deferJob(restartMQTT);
     }
 
     if (server.hasArg("firmware_url")) {
-        strncpy(firmwareConfig.update_url, server.arg("firmware_url").c_str(), sizeof(firmwareConfig.update_url) - 1);
-        saveFirmwareConfig();
+        if (updateField(firmwareConfig.update_url, sizeof(firmwareConfig.update_url), server.arg("firmware_url").c_str())) {
+            markConfigDirty(CONFIG_FIRMWARE);
+            configChanged = true;
+        }
     }
 
-    String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #e8fff4; padding: 10px; border-radius: 4px; margin: 20px 0; color: #28a745; }
-        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-</head>
-<body>
-    <h1>Settings Saved</h1>)"; 
-    
-    page += String("<div class='status'>") + 
-            (configChanged ? "All settings have been updated successfully" : "No changes were made") + 
-            String("</div>");
-            
-    page += R"(
-    <a href='/' class='btn'>Go Back</a>
-</body>
-</html>)";
+    if (server.hasArg("notify_url")) {
+        if (updateField(notifyConfig.url, sizeof(notifyConfig.url), server.arg("notify_url").c_str())) {
+            markConfigDirty(CONFIG_NOTIFY);
+            configChanged = true;
+        }
+    }
 
-    server.send(200, "text/html", page);
+    sendMessagePage(200, "Settings Saved",
+                    configChanged ? "All settings have been updated successfully" : "No changes were made", "/");
 }
 
 void handleReset() {
-    String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #e8fff4; padding: 10px; border-radius: 4px; margin: 20px 0; color: #28a745; }
-    </style>
-</head>
-<body>
-    <h1>Resetting Device...</h1>
-    <div class='status'>Device will restart in a few seconds.</div>
-</body>
-</html>)";
-
-    server.send(200, "text/html", page);
-    delay(1000);
-    resetWiFiSettings();
+    sendMessagePage(200, "Resetting Device...", "Device will restart in a few seconds.", nullptr);
+    deferJob(resetWiFiSettings, DEFERRED_RESPONSE_GRACE_MS);
 }
 
 void handleManualTimeSet() {
@@ -1042,49 +1052,9 @@ void handleManualTimeSet() {
         
         setManualTime(year, month, day, hour, minute);
         
-        String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #e8fff4; padding: 10px; border-radius: 4px; margin: 20px 0; color: #28a745; }
-        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-</head>
-<body>
-    <h1>Time Set</h1>
-    <div class='status'>Time has been updated successfully</div>
-    <a href='/' class='btn'>Go Back</a>
-</body>
-</html>)";
-        server.send(200, "text/html", page);
+        sendMessagePage(200, "Time Set", "Time has been updated successfully", "/");
     } else {
-        String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #ffe6e6; padding: 10px; border-radius: 4px; margin: 20px 0; color: #dc3545; }
-        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-</head>
-<body>
-    <h1>Error</h1>
-    <div class='status'>Missing required time parameters</div>
-    <a href='/' class='btn'>Go Back</a>
-</body>
-</html>)";
-        server.send(400, "text/html", page);
+        sendMessagePage(400, "Error", "Missing required time parameters", "/");
     }
 }
 
@@ -1103,7 +1073,7 @@ void setManualTime(int year, int month, int day, int hour, int minute) {
     
     timeConfig.manual_time_set = true;
     timeConfig.last_manual_set = t;
-    saveTimeConfig();
+    markConfigDirty(CONFIG_TIME);
     
     // Show time in 12-hour format in the log
     int hour12 = hour % 12;
@@ -1127,52 +1097,13 @@ void handleSystemCommand() {
         }
         
         if (isValid) {
-            strlcpy(systemCommandConfig.command, command.c_str(), sizeof(systemCommandConfig.command));
-            saveSystemCommandConfig();
+            if (updateField(systemCommandConfig.command, sizeof(systemCommandConfig.command), command.c_str())) {
+                markConfigDirty(CONFIG_SYSTEM_COMMAND);
+            }
             
-            String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #e8fff4; padding: 10px; border-radius: 4px; margin: 20px 0; color: #28a745; }
-        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-</head>
-<body>
-    <h1>System Command Updated</h1>
-    <div class='status'>System command has been updated successfully</div>
-    <a href='/' class='btn'>Go Back</a>
-</body>
-</html>)";
-            server.send(200, "text/html", page);
+            sendMessagePage(200, "System Command Updated", "System command has been updated successfully", "/");
         } else {
-            String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #ffe6e6; padding: 10px; border-radius: 4px; margin: 20px 0; color: #dc3545; }
-        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-</head>
-<body>
-    <h1>Error</h1>
-    <div class='status'>Invalid system command format. Use only 0s and 1s.</div>
-    <a href='/' class='btn'>Go Back</a>
-</body>
-</html>)";
-            server.send(400, "text/html", page);
+            sendMessagePage(400, "Error", "Invalid system command format. Use only 0s and 1s.", "/");
         }
     } else {
         server.send(400, "text/html", "Missing system command parameter");
@@ -1181,73 +1112,134 @@ void handleSystemCommand() {
 
 void handleSaveFirmwareURL() {
     if (server.hasArg("firmware_url")) {
-        strncpy(firmwareConfig.update_url, server.arg("firmware_url").c_str(), sizeof(firmwareConfig.update_url) - 1);
-        firmwareConfig.update_url[sizeof(firmwareConfig.update_url) - 1] = '\0';
-        saveFirmwareConfig();
+        bool changed = updateField(firmwareConfig.update_url, sizeof(firmwareConfig.update_url), server.arg("firmware_url").c_str());
+        // An unchecked checkbox isn't sent, only the System page form says it's off
+        if (server.hasArg("firmware_form")) {
+            changed |= updateField(firmwareConfig.auto_update, server.hasArg("auto_update"));
+        }
+        if (changed) {
+            markConfigDirty(CONFIG_FIRMWARE);
+        }
         
-        String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1 { color: #333; }
-        .status { background: #e8fff4; padding: 10px; border-radius: 4px; margin: 20px 0; color: #28a745; }
-        .btn { display: inline-block; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-</head>
-<body>
-    <h1>Firmware URL Saved</h1>
-    <div class='status'>The firmware URL has been updated successfully.</div>
-    <a href='/system' class='btn'>Go Back</a>
-</body>
-</html>)";
-        server.send(200, "text/html", page);
+        sendMessagePage(200, "Firmware URL Saved", "The firmware URL has been updated successfully.", "/system");
     } else {
         server.send(400, "text/plain", "Missing firmware_url parameter");
     }
 }
 
+// Web UI assets built into the firmware by compress_web.py. no-cache makes the
+// browser revalidate with If-None-Match and get a 304.
+static void sendWebAsset(const WebAsset& asset) {
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendHeader("ETag", asset.etag);
+    if (server.header("If-None-Match") == asset.etag) {
+        server.setContentLength(0);
+        server.send(304, asset.contentType, "");
+        return;
+    }
+    server.sendHeader("Content-Encoding", "gzip");
+    server.setContentLength(asset.length);
+    server.send(200, asset.contentType, "");
+    server.sendContent_P((PGM_P)asset.data, asset.length);
+}
+
+// Split http(s)://host[:port]/path
+bool parseHttpUrl(const char* url, char* host, size_t hostSize, uint16_t& port, const char*& path, bool allowHttps) {
+    const char* start;
+    if (strncmp(url, "http://", 7) == 0) {
+        start = url + 7;
+        port = 80;
+    } else if (allowHttps && strncmp(url, "https://", 8) == 0) {
+        start = url + 8;
+        port = 443;
+    } else {
+        return false;
+    }
+    const char* slash = strchr(start, '/');
+    size_t hostLen = slash ? (size_t)(slash - start) : strlen(start);
+    path = slash ? slash : "/";
+
+    const char* colon = (const char*)memchr(start, ':', hostLen);
+    if (colon) {
+        port = atoi(colon + 1);
+        hostLen = colon - start;
+    }
+    if (hostLen == 0 || hostLen >= hostSize || port == 0) {
+        return false;
+    }
+    memcpy(host, start, hostLen);
+    host[hostLen] = '\0';
+    return true;
+}
+
+void sendJsonResponse(int code, const JsonDocument& doc) {
+    sampleHeap();   // The document is at its largest here
+    server.setContentLength(measureJson(doc));
+    server.send(code, "application/json", "");
+    BufferedPrint<256> out(server.client());
+    serializeJson(doc, out);
+}
+
+// Registers a route with its requests counted for /metrics
+static void onCounted(const char* uri, HTTPMethod method, std::function<void(void)> handler) {
+    server.on(uri, method, countRequests(uri, method, handler));
+}
+
 void setupWebServer() {
-    server.on("/", handleRoot);
-    server.on("/save", HTTP_POST, handleSave);
-    server.on("/reset", HTTP_POST, handleReset);
-    server.on("/settime", HTTP_POST, handleManualTimeSet);
-    server.on("/systemcommand", HTTP_POST, handleSystemCommand);
-    server.on("/system", handleSystem);
-    server.on("/performUpdate", HTTP_GET, handlePerformUpdate);
-    server.on("/saveFirmwareURL", HTTP_POST, handleSaveFirmwareURL);
+#ifndef ASYNC_HTTP_SERVER
+    static const char* collectedHeaders[] = {"If-None-Match"};
+    server.collectHeaders(collectedHeaders, 1);
+#endif
+    for (const WebAsset& asset : webAssets) {
+        onCounted(asset.uri, HTTP_GET, [&asset]() { sendWebAsset(asset); });
+    }
+
+    onCounted("/", HTTP_ANY, handleRoot);
+    onCounted("/save", HTTP_POST, handleSave);
+    onCounted("/reset", HTTP_POST, handleReset);
+    onCounted("/settime", HTTP_POST, handleManualTimeSet);
+    onCounted("/systemcommand", HTTP_POST, handleSystemCommand);
+    onCounted("/system", HTTP_ANY, handleSystem);
+    onCounted("/performUpdate", HTTP_GET, handlePerformUpdate);
+    onCounted("/api/ota", HTTP_GET, handleOtaStatus);
+    onCounted("/api/ota/upload", HTTP_GET, handleOtaUploadStatus);
+    server.on("/api/ota/upload", HTTP_POST, countRequests("/api/ota/upload", HTTP_POST, handleOtaUploadDone), handleOtaUploadData);
+    onCounted("/saveFirmwareURL", HTTP_POST, handleSaveFirmwareURL);
+    onCounted("/api/boot", HTTP_GET, handleBootProfile);
+    onCounted("/api/ntp", HTTP_GET, handleTimeSyncStatus);
+    onCounted("/api/config", HTTP_GET, handleConfigGet);
+    onCounted("/api/config", HTTP_PATCH, handleConfigPatch);
+    onCounted("/api/config/bundle", HTTP_GET, handleConfigBundleExport);
+    server.on("/api/config/bundle", HTTP_POST, countRequests("/api/config/bundle", HTTP_POST, handleConfigBundleImport), handleConfigBundleUpload);
+    onCounted("/api/live", HTTP_GET, handleLiveSubscribe);
+    onCounted("/api/heap", HTTP_GET, handleHeapStats);
+    onCounted("/api/history", HTTP_GET, handleHistory);
+    onCounted("/metrics", HTTP_GET, handleMetrics);
  
         // Handle firmware update via browser proxy
-    server.on("/update", HTTP_POST, handleUpdateDone, []() {
+    server.on("/update", HTTP_POST, countRequests("/update", HTTP_POST, handleUpdateDone), []() {
         HTTPUpload& upload = server.upload();
         if (upload.status == UPLOAD_FILE_START) {
-            displaySetupMessage("Update Started");
             uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
             if (!Update.begin(maxSketchSpace)) {
                 displaySetupMessage("Update Failed");
             }
-        } else if (upload.status == UPLOAD_FILE_WRITE) {
+            beginOtaProgress("browser upload");
+        } else if (upload.status == UPLOAD_FILE_WRITE && Update.isRunning()) {
+            // Updater gathers these into 4 KB sectors before it touches flash
             if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
                 displaySetupMessage("Write Error");
             } else {
-                char progress[5];
-                snprintf(progress, sizeof(progress), "%d%%", 
-                         (upload.totalSize * 100) / ESP.getFreeSketchSpace());
-                         
-                displaySetupMessageProgress(progress);
+                // The request length includes the multipart framing, close enough for a percentage
+                reportOtaProgress(upload.totalSize + upload.currentSize, upload.contentLength);
             }
         } else if (upload.status == UPLOAD_FILE_END) {
-            if (Update.end(true)) {
-                displaySetupMessage("Update Success");
-            } else {
-                displaySetupMessage("Update Failed");
-            }
+            bool ok = Update.end(true);
+            endOtaProgress(ok);
+            displaySetupMessage(ok ? "Update Success" : "Update Failed");
         } else if (upload.status == UPLOAD_FILE_ABORTED) {
             Update.end();
+            endOtaProgress(false);
             displaySetupMessage("Update Aborted");
         }
         yield();
@@ -1257,9 +1249,24 @@ void setupWebServer() {
     printBoth("Web server started");
 }
 
+static void countPublish(bool ok) {
+    if (ok) {
+        mqttPublishes++;
+    } else {
+        mqttFailures++;
+    }
+}
+
+void restartMQTT() {
+    // Force MQTT reconnection with new settings
+    if (mqttClient.connected()) {
+        mqttClient.disconnect();
+    }
+    setupMQTT();
+}
+
 void setupMQTT() {
-    loadMQTTConfig();
-    
+    // mqttConfig is loaded once in setup() and kept current by handleSave()
     if (mqttConfig.isEmpty()) {
         printBoth("No MQTT configuration found - MQTT disabled");
         return;
@@ -1270,18 +1277,21 @@ void setupMQTT() {
     
     printBothf("Attempting to connect to MQTT broker as %s...", deviceConfig.hostname);
     if (mqttClient.connect(deviceConfig.hostname, mqttConfig.mqtt_user, mqttConfig.mqtt_password)) {
+        mqttReconnects++;
         printBoth("MQTT Connected Successfully");
         
         // Publish discovery configs for temperature sensor
         String tempConfig = "{\"name\":\"" + String(deviceConfig.hostname) + " Temperature\",\"device_class\":\"temperature\",\"state_topic\":\"homeassistant/sensor/" + String(deviceConfig.hostname) + "/temperature/state\",\"unit_of_measurement\":\"°C\",\"unique_id\":\"" + String(deviceConfig.hostname) + "_temp\"}";
-        mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/temperature/config").c_str(), tempConfig.c_str(), true);
+        countPublish(mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/temperature/config").c_str(), tempConfig.c_str(), true));
         
         // Publish discovery configs for humidity sensor
         String humConfig = "{\"name\":\"" + String(deviceConfig.hostname) + " Humidity\",\"device_class\":\"humidity\",\"state_topic\":\"homeassistant/sensor/" + String(deviceConfig.hostname) + "/humidity/state\",\"unit_of_measurement\":\"%\",\"unique_id\":\"" + String(deviceConfig.hostname) + "_humidity\"}";
-        mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/humidity/config").c_str(), humConfig.c_str(), true);
+        countPublish(mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/humidity/config").c_str(), humConfig.c_str(), true));
         
         mqttClient.subscribe(("homeassistant/" + String(deviceConfig.hostname) + "/command").c_str());
+        subscribeMqttOta();
     } else {
+        mqttFailures++;
         int state = mqttClient.state();
         String errorMsg = "Initial MQTT connection failed, state: ";
         switch (state) {
@@ -1302,6 +1312,11 @@ void setupMQTT() {
 }
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
+    // Firmware chunks are binary and arrive by the hundred, they skip the log
+    if (handleMqttOtaMessage(topic, payload, length)) {
+        return;
+    }
+
     String message = "Message arrived on topic: ";
     message += topic;
     printBoth(message);
@@ -1327,9 +1342,12 @@ void reconnectMQTT() {
     // Try to connect once (non-blocking approach)
     printBothf("Attempting MQTT connection as %s...", deviceConfig.hostname);
     if (mqttClient.connect(deviceConfig.hostname, mqttConfig.mqtt_user, mqttConfig.mqtt_password)) {
+        mqttReconnects++;
         printBoth("Connected to MQTT broker");
         mqttClient.subscribe(("homeassistant/" + String(deviceConfig.hostname) + "/command").c_str());
+        subscribeMqttOta();
     } else {
+        mqttFailures++;
         int state = mqttClient.state();
         String errorMsg = "Connection failed, state: ";
         switch (state) {
@@ -1359,8 +1377,10 @@ void publishMQTTData(float temperature, float humidity) {
     if (!mqttClient.connected()) {
         printBoth("MQTT disconnected, attempting to reconnect...");
         if (mqttClient.connect(deviceConfig.hostname, mqttConfig.mqtt_user, mqttConfig.mqtt_password)) {
+            mqttReconnects++;
             printBoth("connected");
         } else {
+            mqttFailures++;
             printBoth("failed");
             return; // Return if can't connect, don't block
         }
@@ -1372,11 +1392,11 @@ void publishMQTTData(float temperature, float humidity) {
     // Publish temperature and humidity to state topics using the custom hostname
     char tempPayload[16];
     snprintf(tempPayload, sizeof(tempPayload), "%.1f", temperature);
-    mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/temperature/state").c_str(), tempPayload, true);
+    countPublish(mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/temperature/state").c_str(), tempPayload, true));
 
     char humPayload[16];
     snprintf(humPayload, sizeof(humPayload), "%.1f", humidity);
-    mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/humidity/state").c_str(), humPayload, true);
+    countPublish(mqttClient.publish(("homeassistant/sensor/" + String(deviceConfig.hostname) + "/humidity/state").c_str(), humPayload, true));
 }
 
 void setupTelnet() {
@@ -1395,6 +1415,37 @@ void handleTelnet() {
             telnetServer.accept().stop(); // Reject new client
         }
     }
+
+    // Collect a command line without blocking the loop
+    static char commandBuf[32];
+    static uint8_t commandLen = 0;
+    while (telnetClient && telnetClient.connected() && telnetClient.available()) {
+        char c = telnetClient.read();
+        if (c == '\n') {
+            commandBuf[commandLen] = '\0';
+            handleTelnetCommand(commandBuf);
+            commandLen = 0;
+        } else if (c >= ' ' && c <= '~' && commandLen < sizeof(commandBuf) - 1) {
+            commandBuf[commandLen++] = c;
+        }
+    }
+}
+
+void handleTelnetCommand(const char* command) {
+    if (command[0] == '\0') {
+        return;
+    }
+    if (strcmp(command, "boot") == 0) {
+        printBootProfile(telnetClient);
+    } else if (strcmp(command, "ntp") == 0) {
+        printTimeSyncEvents(telnetClient);
+    } else if (strcmp(command, "help") == 0) {
+        telnetClient.println("Commands:");
+        telnetClient.println("  boot  - setup() phase timings of the last boots (ms)");
+        telnetClient.println("  ntp   - clock state and recent NTP sync events");
+    } else {
+        telnetClient.printf("Unknown command: %s (try 'help')\n", command);
+    }
 }
 
 void printBoth(const char* message) {
@@ -1421,54 +1472,17 @@ void printBothf(const char* format, ...) {
     printBoth(buf);
 }
 
-void handleSystem() {
-    String page = R"(
-<!DOCTYPE html>
+static const char SYSTEM_PAGE[] PROGMEM = R"(<!DOCTYPE html>
 <html>
 <head>
     <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; max-width: 600px; margin: 0 auto; }
-        h1, h2 { color: #333; }
-        form { background: #f5f5f5; padding: 20px; border-radius: 8px; margin: 15px 0; }
-        .form-group { margin-bottom: 15px; }
-        label { display: block; margin-bottom: 5px; }
-        input[type='text'], input[type='number'], input[type='password'] { 
-            width: 100%; padding: 8px; font-size: 16px; border: 1px solid #ddd; 
-            border-radius: 4px; box-sizing: border-box; 
-        }
-        input[type='submit'], input[type='button'] { 
-            background: #007bff; color: white; border: none; padding: 10px 20px; 
-            font-size: 16px; border-radius: 4px; cursor: pointer; width: 100%; 
-            margin-bottom: 10px;
-        }
-        input[type='submit']:hover, input[type='button']:hover { background: #0056b3; }
-        input[type='button'] { background: #17a2b8; }
-        input[type='button']:hover { background: #138496; }
-        .status { 
-            background: #e8f4fd; padding: 10px; border-radius: 4px; margin-bottom: 20px; 
-        }
-        .reset-btn { background: #dc3545; }
-        .reset-btn:hover { background: #c82333; }
-        .home-btn { 
-            display: block; background: #28a745; color: white; border: none; padding: 12px 20px; 
-            font-size: 16px; border-radius: 4px; cursor: pointer; width: 100%; 
-            margin: 20px 0; text-align: center; text-decoration: none;
-        }
-        .home-btn:hover { background: #218838; }
-        .footer { 
-            margin-top: 30px; padding: 20px; background: #f8f9fa; 
-            border-radius: 4px; text-align: center; 
-        }
-        .footer p { margin: 5px 0; color: #666; }
-    </style>
+    <link rel='stylesheet' href='/style.css'>
 </head>
 <body>
     <h1>System Administration</h1>
-    <div class='status'>IP Address: )" + WiFi.localIP().toString() + R"(</div>
+    <div class='status'>IP Address: {{ip}}</div>
 
-    
-<!-<!-- System Command Form -->
+    <!-- System Command Form -->
     <form action='/systemcommand' method='POST' style='margin-top: 20px;'>
         <h2>System Command</h2>
         <div class='form-group'>
@@ -1492,7 +1506,13 @@ void handleSystem() {
         <h2>Firmware Update</h2>
         <div class='form-group'>
             <label for='firmware_url'>Firmware URL:</label>
-            <input type='text' id='firmware_url' name='firmware_url' value=')" + String(firmwareConfig.update_url) + R"('>
+            <input type='text' id='firmware_url' name='firmware_url' value='{{firmware_url}}'>
+        </div>
+        <div class='form-group'>
+            <input type='hidden' name='firmware_form' value='1'>
+            <input type='checkbox' id='auto_update' name='auto_update' value='1' {{auto_update_checked}}>
+            <label for='auto_update'>Install updates automatically</label>
+            <small style='display: block; margin-top: 5px; color: #666;'>Otherwise the clock only checks every 6 hours and /api/ota reports a newer version</small>
         </div>
         <input type='submit' value='Save Firmware URL'>
     </form>
@@ -1501,97 +1521,70 @@ void handleSystem() {
         <input type='submit' value='Perform Update'>
     </form>
 
+    <!-- Connect Notification -->
+    <form action='/save' method='POST'>
+        <h2>Notifications</h2>
+        <div class='form-group'>
+            <label for='notify_url'>Notify URL:</label>
+            <input type='text' id='notify_url' name='notify_url' maxlength='127' value='{{notify_url}}'>
+            <small style='display: block; margin-top: 5px; color: #666;'>http:// endpoint that receives a POST on every boot. Leave empty for ntfy.sh/&lt;MAC&gt;</small>
+        </div>
+        <input type='submit' value='Save Notify URL'>
+    </form>
+
     <!-- Back to Main Page -->
     <a href='/' >Back to Main Page</a>
 
     <div class='footer'>
         <p>Designed by: Arjun Bhattacharjee (mymail.arjun@gmail.com)</p>
-        <p>System Storage Remaining: )" + String((ESP.getFlashChipSize() - ESP.getSketchSize()) / (1024.0 * 1024.0), 2) + R"( MB</p>
+        <p>System Storage Remaining: {{storage_mb}} MB</p>
+        <p>Config Flash Writes: {{config_committed}} committed, {{config_avoided}} avoided</p>
+        <p>Notifications: {{notify_sent}} sent, {{notify_failed}} failed, {{notify_dropped}} dropped</p>{{http_pool}}
     </div>
 </body>
 </html>)";
 
-    server.send(200, "text/html", page);
+static void fillSystemPage(Print& out, const char* name) {
+    if (strcmp(name, "ip") == 0) out.print(WiFi.localIP());
+    else if (strcmp(name, "firmware_url") == 0) printHtmlEscaped(out, firmwareConfig.update_url);
+    else if (strcmp(name, "auto_update_checked") == 0) out.print(firmwareConfig.auto_update ? "checked" : "");
+    else if (strcmp(name, "notify_url") == 0) printHtmlEscaped(out, notifyConfig.url);
+    else if (strcmp(name, "storage_mb") == 0) out.print((ESP.getFlashChipSize() - ESP.getSketchSize()) / (1024.0 * 1024.0), 2);
+    else if (strcmp(name, "config_committed") == 0) out.print(configWritesCommitted);
+    else if (strcmp(name, "config_avoided") == 0) out.print(configWritesAvoided);
+    else if (strcmp(name, "notify_sent") == 0) out.print(notifySent);
+    else if (strcmp(name, "notify_failed") == 0) out.print(notifyFailed);
+    else if (strcmp(name, "notify_dropped") == 0) out.print(notifyDropped);
+#ifdef ASYNC_HTTP_SERVER
+    else if (strcmp(name, "http_pool") == 0) {
+        out.printf("<p>HTTP Connections: %u of %u in use, %lu turned away</p>",
+                   server.activeConnections(), HTTP_MAX_CONNECTIONS, (unsigned long)server.rejectedConnections());
+    }
+#endif
+}
+
+void handleSystem() {
+    sendTemplate(200, SYSTEM_PAGE, fillSystemPage);
 }
 
 void handlePerformUpdate() {
-    // ...existing code...
     if (strlen(firmwareConfig.update_url) == 0) {
         server.send(200, "text/plain", "Set Update URL on System Settings page");
         return;
     }
-    String page = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <meta name='viewport' content='width=device-width, initial-scale=1.0'>
-    <style>
-        body { font-family: Arial, sans-serif; max-width: 800px; margin: 20px auto; padding: 0 20px; }
-        .status { margin: 20px 0; padding: 15px; border-radius: 4px; }
-        .updating { background: #fff3cd; color: #856404; }
-        .success { background: #d4edda; color: #155724; }
-        .error { background: #f8d7da; color: #721c24; }
-        .btn { display: none; padding: 10px 20px; background: #007bff; color: white; 
-               text-decoration: none; border-radius: 4px; margin-top: 20px; }
-        .btn:hover { background: #0056b3; }
-    </style>
-    <script>
-        async function performUpdate() {
-            const statusDiv = document.getElementById('status');
-            const backButton = document.getElementById('backButton');
-            
-            try {
-                const url = ')" + String(firmwareConfig.update_url) + R"(';
-                if (url.length === 0) {
-                    statusDiv.className = 'status error';
-                    statusDiv.textContent = 'Set Update URL on System Settings page';
-                    backButton.style.display = 'inline-block';
-                    return;
-                }
-                statusDiv.className = 'status updating';
-                statusDiv.textContent = 'Downloading firmware...';
-                
-                const response = await fetch(url);
-                if (!response.ok) {
-                    throw new Error('Failed to download firmware');
-                }
-
-                const blob = await response.blob();
-                const formData = new FormData();
-                formData.append('update', blob, 'firmware.bin');
-
-                statusDiv.textContent = 'Installing firmware...';
-                const uploadResponse = await fetch('/update', {
-                    method: 'POST',
-                    body: formData
-                });
-
-                if (uploadResponse.ok) {
-                    statusDiv.className = 'status success';
-                    statusDiv.textContent = 'Update successful! Device will restart automatically.';
-                } else {
-                    throw new Error('Firmware installation failed');
-                }
-            } catch (error) {
-                statusDiv.className = 'status error';
-                statusDiv.textContent = 'Update failed: ' + error.message;
-            } finally {
-                backButton.style.display = 'inline-block';
-            }
-        }
-
-        window.onload = performUpdate;
-    </script>
-</head>
-<body>
-    <h1>Firmware Update</h1>
-    <div id="status" class="status updating">Starting update...</div>
-    <a href="/" class="btn" id="backButton">Back to Home</a>
-</body>
-</html>)";
+    // The clock fetches the image itself, the browser only has to start it
+    const char* error = startPullOta(firmwareConfig.update_url, true);
+    if (error) {
+        sendMessagePage(409, "Update Not Started", error, "/system");
+        return;
+    }
+    sendMessagePage(200, "Updating Firmware",
+                    "The clock is downloading the new firmware and shows its progress. It restarts when the update is done.", "/system");
+}
 
-    server.send(200, "text/html", page);
-    // ...existing code...
+void restartAfterUpdate() {
+    flushPendingConfig(true);  // Don't lose settings still waiting for their debounced commit
+    ESP.restart();
 }
 
 // Handle firmware update completion
@@ -1603,7 +1596,6 @@ void handleUpdateDone() {
         server.send(200, "text/plain", "OK");
         displaySetupMessage("Update Success");
         // Give the browser some time to receive the response before rebooting
-        delay(1000);
-        ESP.restart();
+        deferJob(restartAfterUpdate, DEFERRED_RESPONSE_GRACE_MS);
     }
 }
\ No newline at end of file
@@ -1,4 +1,3 @@
-#include <DHT.h>
 #include <MD_Parola.h>
 #include <MD_MAX72XX.h>
 #include <SPI.h>
@@ -10,15 +9,25 @@
 #include <WiFiManager.h>
 #include <ESP8266WebServer.h>
 #include "WiFiSetup.h"
+#include "BootProfiler.h"
+#include "Notifier.h"
+#include "TimeSync.h"
+#include "LiveEvents.h"
+#include "HeapStats.h"
+#include "Metrics.h"
+#include "DeferredJobs.h"
+#include "PageTemplate.h"
+#include "OtaUpdate.h"
+#include "OtaUpload.h"
+#include "MqttOta.h"
+#include "DhtSensor.h"
+#include "SensorHistory.h"
 #include <time.h>
-#include <ESP8266HTTPClient.h>
 
 // Global variables
-time_t lastTimeSync = 0;               // Track last sync time
 unsigned long lastDisplayChange = 0;   // Track when display was last changed
 unsigned long lastBrightnessCheck = 0; // Track when brightness was last updated
 uint8_t currentDisplay = 0;            // 0 = time, 1 = date, 2 = temp, 3 = humidity
-bool unableToSetTime = false; // Flag to indicate if manual time was set
 #define LDR_PIN A0                     // Analog pin for LDR
 #define BRIGHTNESS_CHECK_INTERVAL 1000 // Check brightness every 1 second
 #define MIN_ANALOG_VALUE 1             // Minimum analog reading (darkness)
@@ -62,8 +71,6 @@ void updateDisplaySequence()
 
 // DHT22 settings
 #define DHTPIN D2
-#define DHTTYPE DHT22
-DHT dht(DHTPIN, DHTTYPE);
 
 // MAX7219 settings
 #define HARDWARE_TYPE MD_MAX72XX::FC16_HW
@@ -133,11 +140,12 @@ void displaySetupMessage(const char *message)
         delay(10); // Small delay to ensure smooth animation
     }
 }
-void displaySetupMessageProgress(const char *message)
+// Firmware update progress goes on the second display, the time keeps its own
+void displayOtaProgress(const char *message)
 {
-
-    setupDisplay.displayText(message, PA_CENTER, 0, 0, PA_NO_EFFECT, PA_NO_EFFECT);
-    setupDisplay.displayAnimate(); // Single call without waiting
+    myDisplay.displayClear();
+    myDisplay.displayText(message, PA_CENTER, 0, 0, PA_NO_EFFECT, PA_NO_EFFECT);
+    myDisplay.displayAnimate(); // Single call without waiting
 }
 void abnormalLoop()
 {
@@ -155,6 +163,7 @@ void abnormalLoop()
     {
         ArduinoOTA.handle();
         server.handleClient(); // Handle web server requests in AP mode
+        handleTemplateStreams();
 
         // Switch messages periodically
         unsigned long currentMillis = millis();
@@ -173,69 +182,9 @@ void abnormalLoop()
     }
 }
 
-void setupTime()
+uint8_t getDisplayIntensity()
 {
-    // Load timezone configuration
-    loadTimeConfig();
-
-    // Try NTP sync first
-    configTime(timeConfig.timezone_offset, 0, "pool.ntp.org", "time.nist.gov");
-    printBothf("Setting up time with timezone %s (offset: %d seconds)", timeConfig.timezone_name, timeConfig.timezone_offset);
-    // displaySetupMessage("Time sync...");
-
-    // Add timeout for NTP sync (30 seconds)
-    unsigned long startAttempt = millis();
-    bool syncSuccess = false;
-
-    while (millis() - startAttempt < 30000)
-    {                        // 30 second timeout
-        ArduinoOTA.handle(); // Add OTA handling while waiting
-        if (time(nullptr) > 1600000000)
-        { // Valid time received (after 2020)
-            syncSuccess = true;
-            break;
-        }
-        delay(100); // Reduced delay to check OTA more frequently
-        if (telnetClient && telnetClient.connected())
-        {
-            telnetClient.print(".");
-        }
-    }
-
-    if (syncSuccess)
-    {
-        printBoth("\nTime synchronized via NTP");
-        displaySetupMessage("Time Synced!");
-        lastTimeSync = time(nullptr);
-    }
-    else
-    {
-        printBoth("\nNTP sync failed - Please set time manually");
-        displaySetupMessage("Set time manually");
-        // Initialize with a default time if no manual time was previously set
-        if (!timeConfig.manual_time_set)
-        {
-            // Set to 2024-01-01 00:00:00 as fallback
-            setManualTime(2024, 1, 1, 0, 0);
-            unableToSetTime = true; // Flag to indicate manual time was set
-        }
-    }
-}
-
-void syncTimeIfNeeded()
-{
-    time_t now = time(nullptr);
-    struct tm *timeInfo = localtime(&now);
-
-    // Check if it's 3 AM and if we haven't synced in the last hour
-    if (timeInfo->tm_hour == 3 && (now - lastTimeSync) > 3600)
-    {
-        printBoth("Performing daily time sync...");
-        displaySetupMessage("Daily Time Sync...");
-        configTime(timeConfig.timezone_offset, 0, "pool.ntp.org", "time.nist.gov");
-        lastTimeSync = now;
-        printBoth("Time resynchronized");
-    }
+    return displayConfig.auto_brightness ? lastSetIntensity : displayConfig.man_brightness;
 }
 
 // Update the brightness method to include a check for auto brightness
@@ -246,6 +195,7 @@ void updateBrightness()
         // If auto brightness is disabled, set manual brightness and return
         myDisplay.setIntensity(displayConfig.man_brightness);
         timeDisplay.setIntensity(displayConfig.man_brightness);
+        liveUpdateIntensity(displayConfig.man_brightness);
         return;
     }
 
@@ -321,10 +271,56 @@ void updateBrightness()
             myDisplay.setIntensity(lastSetIntensity);
             timeDisplay.setIntensity(lastSetIntensity);
         }
+        liveUpdateIntensity(lastSetIntensity);
         lastUpdateTime = millis();
     }
 }
 
+// Redraw the time once a second. Also called from the OTA progress callbacks,
+// which keep loop() waiting for as long as an upload runs.
+void updateTimeDisplay()
+{
+    static unsigned long lastTimeUpdate = 0;
+    unsigned long currentMillis = millis();
+    if (currentMillis - lastTimeUpdate < 1000)
+    {
+        return;
+    }
+
+    time_t now = time(nullptr);
+    struct tm *timeinfo = localtime(&now);
+    char timeStr[10];
+    if (!isTimeSet())
+    {
+        // Waiting for the first NTP sync or a manual time set
+        strcpy(timeStr, "--:--");
+    }
+    else if (displayConfig.use_24h_format)
+    {
+        strftime(timeStr, sizeof(timeStr), "%H:%M", timeinfo);
+    }
+    else
+    {
+        strftime(timeStr, sizeof(timeStr), "%I:%M", timeinfo);
+        if (timeStr[0] == '0')
+            timeStr[0] = ' '; // Remove leading zero
+        // Add A or P for AM/PM
+        char ampm = (timeinfo->tm_hour < 12) ? 'A' : 'P';
+        size_t len = strlen(timeStr);
+        timeStr[len] = ' ';
+        timeStr[len + 1] = ampm;
+        timeStr[len + 2] = '\0';
+    }
+    timeDisplay.displayText(timeStr, PA_CENTER, 25, 0, PA_NO_EFFECT, PA_NO_EFFECT);
+    liveUpdateTime(timeStr);
+
+    while (!timeDisplay.displayAnimate())
+    {
+        delay(10);
+    }
+    lastTimeUpdate = currentMillis;
+}
+
 #define MAX_COMMAND_LENGTH 31
 
 // Helper function to check if a specific feature bit is enabled
@@ -339,9 +335,12 @@ void setup()
 {
     // Initialize Serial Monitor
     Serial.begin(9600);
+    bootProfileStart();
+    setupMetrics();
     printBoth("DHT22 and MAX7219 Display");
 
     // Initialize MAX7219 display instances separately
+    bootPhaseBegin(BOOT_PHASE_DISPLAY);
     // Setup display for system messages (uses default font)
     setupDisplay.begin();
     setupDisplay.setIntensity(0);
@@ -369,8 +368,10 @@ void setup()
     // for (uint8_t i = 0; i < MAX_DEVICES; i++) {
     //     timeDisplay.getZoneDevice(0)->getGraphicDevice()->setTransform(MD_MAX72XX::TFUD);
     // }
+    bootPhaseEnd(BOOT_PHASE_DISPLAY);
 
     // Initialize SPIFFS
+    bootPhaseBegin(BOOT_PHASE_FS);
     if (!LittleFS.begin())
     {
         Serial.println("Failed to mount SPIFFS - Formatting filesystem...");
@@ -392,45 +393,51 @@ void setup()
         }
     }
 
+    bootPhaseEnd(BOOT_PHASE_FS);
+
     // Check for reset button press
     // checkResetButton();
 
+    // Before anything that can receive an update, AP mode included
+    setupUpdateSigning();
+
     // Display message if WiFi is not connected and AP mode is starting
+    bootPhaseBegin(BOOT_PHASE_WIFI);
     displaySetupMessage("Connecting to wifi...");
 
     // Connect to Wi-Fi
     setupWiFi();
+    bootPhaseEnd(BOOT_PHASE_WIFI);
 
 
     // Initialize Telnet server
     setupTelnet();
 
     // Setup OTA
+    bootPhaseBegin(BOOT_PHASE_OTA);
     ArduinoOTA.setHostname(deviceConfig.hostname);
     ArduinoOTA.onStart([]()
                        {
-        setupDisplay.displayClear();
-        setupDisplay.displayText("OTA", PA_CENTER, 0, 0, PA_NO_EFFECT, PA_NO_EFFECT);
-        setupDisplay.displayAnimate(); });
+        if (ArduinoOTA.getCommand() == U_FS) {
+            LittleFS.end(); // The whole filesystem, config files included, is being replaced
+        }
+        beginOtaProgress("ArduinoOTA"); });
     ArduinoOTA.onEnd([]()
                      {
-        setupDisplay.displayText("Done", PA_CENTER, 0, 0, PA_NO_EFFECT, PA_NO_EFFECT);
-        setupDisplay.displayAnimate(); });
+        // ArduinoOTA restarts right after this. A filesystem image has just
+        // replaced LittleFS, so only a firmware update keeps pending settings.
+        if (ArduinoOTA.getCommand() == U_FLASH) {
+            flushPendingConfig(true);
+        }
+        endOtaProgress(true);
+        displayOtaProgress("Done"); });
     ArduinoOTA.onProgress([](unsigned int progress, unsigned int total)
                           {
-        static int lastShownPercentage = 0;
-        int currentPercentage = (progress / (total / 100));
-        
-        // Only update display if percentage changed by 5% or more
-        if (currentPercentage >= lastShownPercentage + 1 || currentPercentage == 100) {
-            char progressMessage[5];
-            snprintf(progressMessage, sizeof(progressMessage), "%u%%", currentPercentage);
-            setupDisplay.displayText(progressMessage, PA_CENTER, 0, 0, PA_NO_EFFECT, PA_NO_EFFECT);
-            setupDisplay.displayAnimate(); // Single call without waiting
-            lastShownPercentage = currentPercentage;
-        } });
+        // Called for every packet, the redraw is rate limited
+        reportOtaProgress(progress, total); });
     ArduinoOTA.onError([](ota_error_t error)
                        {
+        endOtaProgress(false);
         Serial.printf("Error[%u]: ", error);
         if (error == OTA_AUTH_ERROR) displaySetupMessage("Auth Failed");
         else if (error == OTA_BEGIN_ERROR) displaySetupMessage("Begin Failed");
@@ -438,6 +445,7 @@ void setup()
         else if (error == OTA_RECEIVE_ERROR) displaySetupMessage("Receive Failed");
         else if (error == OTA_END_ERROR) displaySetupMessage("End Failed"); });
     ArduinoOTA.begin();
+    bootPhaseEnd(BOOT_PHASE_OTA);
     printBoth("OTA initialized");
     // displaySetupMessage("OTA ready");
 
@@ -446,9 +454,10 @@ void setup()
     // displaySetupMessage(WiFi.localIP().toString().c_str());
 
     // Initialize DHT22 sensor
-    dht.begin();
+    dhtBegin(DHTPIN);
 
     // Load all configurations
+    bootPhaseBegin(BOOT_PHASE_CONFIG);
     loadMQTTConfig();
     loadTimeConfig();
     loadDisplayConfig();
@@ -456,37 +465,31 @@ void setup()
     loadSystemCommandConfig(); // Load system command configuration
     // Load firmware configuration
     loadFirmwareConfig();
+    loadNotifyConfig();
+    bootPhaseEnd(BOOT_PHASE_CONFIG);
     // Print system command status (only to Serial/Telnet, not display)
     printBoth("System command configuration loaded");
 
     updateDisplaySequence();
 
+    bootPhaseBegin(BOOT_PHASE_TIME);
     setupTime();
+    bootPhaseEnd(BOOT_PHASE_TIME);
+    bootPhaseBegin(BOOT_PHASE_WEBSERVER);
     setupWebServer();
+    bootPhaseEnd(BOOT_PHASE_WEBSERVER);
     if (WiFi.status() == WL_CONNECTED)
     {
 
-    // Send the IP address to ntfy.sh with the device's MAC address
-    String macAddress = WiFi.macAddress();
-    macAddress.replace(":", ""); // Remove colons from MAC address
-    String ntfyUrl = "http://ntfy.sh/" + macAddress;
+    // Queue the IP address for the notify endpoint (ntfy.sh/<MAC> by default),
+    // it is delivered from loop() so boot never waits on the network
+    bootPhaseBegin(BOOT_PHASE_NTFY);
     String message = String(deviceConfig.hostname) + " connected as IP: " + WiFi.localIP().toString();
-    
-    static WiFiClient wifiClient;  // Make it static so it persists
-    HTTPClient http;
-    if (http.begin(wifiClient, ntfyUrl)) {  // Check if begin was successful
-        http.addHeader("Content-Type", "text/plain");
-        int httpResponseCode = http.POST(message);
-        if (httpResponseCode > 0) {
-            Serial.printf("Message sent to ntfy.sh with response code: %d\n", httpResponseCode);
-        } else {
-            Serial.printf("Failed to send message to ntfy.sh. Error: %s\n", http.errorToString(httpResponseCode).c_str());
-        }
-        http.end();
-    } else {
-        Serial.println("Failed to begin HTTP client");
-    }
+    notifyEnqueue(message.c_str());
+    bootPhaseEnd(BOOT_PHASE_NTFY);
+        bootPhaseBegin(BOOT_PHASE_MQTT);
         setupMQTT();
+        bootPhaseEnd(BOOT_PHASE_MQTT);
 }
     else
     {
@@ -507,15 +510,25 @@ void setup()
     }
 
     // lastSetIntensity=-1;
+    bootProfileFinish();
 }
 
 void loop()
 {
+    recordLoopPass();      // Loop latency for /metrics
     ArduinoOTA.handle();   // Handle OTA updates
     MDNS.update();         // Handle mDNS updates
     server.handleClient(); // Handle web server requests
+    handleTemplateStreams(); // Rest of long pages, a slice per pass
+    runDeferredJobs();     // Side effects handlers left for after their response
+    sampleHeap();          // Track the heap low-water mark for /api/heap
     handleTelnet();        // Handle telnet connections
-    syncTimeIfNeeded();
+    flushPendingConfig();  // Commit debounced config changes to flash
+    handleNotifier();      // Deliver queued notifications
+    handleTimeSync();      // Slew the clock by the estimated oscillator drift
+    handleLiveEvents();    // Keep live dashboard subscribers alive
+    handlePullOta();       // Stream a firmware download into flash
+    handleOtaUpload();     // Expire an abandoned chunked upload
 
     // Reconnect MQTT if needed
     if (!mqttClient.connected())
@@ -523,9 +536,10 @@ void loop()
         reconnectMQTT();
     }
     mqttClient.loop();
+    handleMqttOta();       // Acks for a firmware update arriving over MQTT
+    updateSensorHistory(); // Close the minute for /api/history
 
     static unsigned long lastReadTime = 0;
-    static unsigned long lastTimeUpdate = 0;
     static float lastTemp = 0;
     static float lastHumidity = 0;
     unsigned long currentMillis = millis();
@@ -536,45 +550,28 @@ void loop()
         updateBrightness();
         lastBrightnessCheck = currentMillis;
     }
-    // Update time display every second
-    if (currentMillis - lastTimeUpdate >= 1000)
-    {
-        time_t now = time(nullptr);
-        struct tm *timeinfo = localtime(&now);
-        char timeStr[10];
-        if (displayConfig.use_24h_format)
-        {
-            strftime(timeStr, sizeof(timeStr), "%H:%M", timeinfo);
-        }
-        else
-        {
-            strftime(timeStr, sizeof(timeStr), "%I:%M", timeinfo);
-            if (timeStr[0] == '0')
-                timeStr[0] = ' '; // Remove leading zero
-            // Add A or P for AM/PM
-            char ampm = (timeinfo->tm_hour < 12) ? 'A' : 'P';
-            size_t len = strlen(timeStr);
-            timeStr[len] = ' ';
-            timeStr[len + 1] = ampm;
-            timeStr[len + 2] = '\0';
-        }
-        timeDisplay.displayText(timeStr, PA_CENTER, 25, 0, PA_NO_EFFECT, PA_NO_EFFECT);
-
-        while (!timeDisplay.displayAnimate())
-        {
-            delay(10);
-        }
-        lastTimeUpdate = currentMillis;
-    }
+    updateTimeDisplay();
 
-    // Read DHT sensor every 2 seconds
+    // Start a DHT conversion every 2 seconds, it is decoded on a later pass
     if (currentMillis - lastReadTime >= 2000)
     {
-        float humidity = dht.readHumidity();
-        float temperature = dht.readTemperature(!displayConfig.use_celsius); // true = Fahrenheit
+        dhtStart();
+        lastReadTime = currentMillis;
+    }
+    DhtStatus dhtStatus = dhtPoll();
+    if (dhtStatus != DHT_IDLE && dhtStatus != DHT_BUSY)
+    {
+        recordDhtRead(dhtStatus == DHT_OK, dhtCpuUs);
 
-        if (!isnan(humidity) && !isnan(temperature))
+        if (dhtStatus == DHT_OK)
         {
+            float humidity = dhtHumidity();
+            float temperature = dhtTemperature();
+            if (!displayConfig.use_celsius)
+            {
+                temperature = temperature * 1.8f + 32;
+            }
+
             // Apply calibration adjustments
             temperature += displayConfig.temp_delta;
             humidity += displayConfig.humidity_delta;
@@ -582,15 +579,18 @@ void loop()
             // Constrain humidity to valid range (0-100%)
             humidity = constrain(humidity, 0.0, 100.0);
 
+            // History stays in Celsius whatever the display shows
+            recordHistoryReading(displayConfig.use_celsius ? temperature : (temperature - 32) / 1.8f, humidity);
+
             lastTemp = temperature;
             lastHumidity = humidity;
             publishMQTTData(temperature, humidity);
+            liveUpdateReading(temperature, humidity);
         }
-        lastReadTime = currentMillis;
     }
 
-    // Update display based on sequence
-    if (currentMillis - lastDisplayChange >= (displayDurations[currentDisplay] * 1000))
+    // Update display based on sequence, firmware update progress has it meanwhile
+    if (currentMillis - lastDisplayChange >= (displayDurations[currentDisplay] * 1000) && !isOtaInProgress())
     {
         // Check WiFi connectivity and display CUT WiFi sign if disconnected
 
@@ -609,6 +609,7 @@ void loop()
 
             myDisplay.displayClear();
             updateDisplaySequence();
+            liveUpdateDisplayItem(displaySequence[currentDisplay]);
             switch (displaySequence[currentDisplay])
             {
             case 1:
@@ -673,23 +674,4 @@ void loop()
         }
         lastWiFiCheckTime = millis(); // Update the last check time
     }
-
-    // Add logic to check unableToSetTime and call retryWiFiSetup every 1 minute
-    static unsigned long lastTimeCheck = 0;
-    if (millis() - lastTimeCheck >= 600000)
-    { // Check every 1 minute
-        if (unableToSetTime)
-        {
-//check if date is 01-01-2024
-            time_t now = time(nullptr);
-            struct tm *timeinfo = localtime(&now);
-            if (timeinfo->tm_year == 124 && timeinfo->tm_mon == 0 && timeinfo->tm_mday == 1)
-            {
-                //reset esp
-                ESP.restart();
-
-            }
-        }
-        lastTimeCheck = millis(); // Update the last check time
-    }
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+import os
+
+# Builds public.key into include/UpdateSigningKey.h. With a key built in, Update
+# only commits images signed with the matching private.key - move_firmware.py
+# signs every image it publishes - however they arrive: pull OTA, /update, the
+# chunked upload, MQTT or ArduinoOTA. Without one, updates aren't authenticated:
+# they still work, https included, and /api/ota reports "verified": false.
+#
+# Create the pair once, next to platformio.ini, and keep private.key out of git:
+#   openssl genrsa -out private.key 2048
+#   openssl rsa -in private.key -outform PEM -pubout -out public.key
+
+def render_header(pem):
+    lines = [
+        "// Generated by update_signing.py from public.key - edit that file, not this one",
+        "",
+        "#pragma once",
+        "",
+    ]
+    if pem is None:
+        lines.append("// No public.key: update images aren't signed or checked")
+    else:
+        lines.append("#define OTA_SIGNING_KEY \\")
+        pem_lines = pem.strip().splitlines()
+        for index, line in enumerate(pem_lines):
+            end = " \\" if index < len(pem_lines) - 1 else ""
+            lines.append(f'    "{line.strip()}\\n"{end}')
+    return "\n".join(lines) + "\n"
+
+
+def update_signing(project_dir):
+    key_path = os.path.join(project_dir, "public.key")
+    header_path = os.path.join(project_dir, "include", "UpdateSigningKey.h")
+
+    pem = None
+    if os.path.exists(key_path):
+        with open(key_path, "r") as f:
+            pem = f.read()
+        if "BEGIN PUBLIC KEY" not in pem:
+            raise ValueError(f"{key_path} is not a PEM public key")
+
+    header = render_header(pem)
+    if os.path.exists(header_path):
+        with open(header_path, "r") as f:
+            if f.read() == header:
+                return
+
+    with open(header_path, "w") as f:
+        f.write(header)
+    print(f"Wrote {header_path} ({'signed updates' if pem else 'no signing key'})")
+
+try:
+    Import("env")
+    update_signing(env.subst("$PROJECT_DIR"))
+except NameError:
+    # Run directly: python update_signing.py
+    update_signing(os.path.dirname(os.path.abspath(__file__)))
@@ -0,0 +1,58 @@
+function setCurrentDateTime() {
+  const now = new Date();
+  document.getElementById('year').value = now.getFullYear();
+  document.getElementById('month').value = now.getMonth() + 1;
+  document.getElementById('day').value = now.getDate();
+  let hours = now.getHours();
+  const ampm = hours >= 12 ? 'P' : 'A';
+  hours = hours % 12;
+  hours = hours ? hours : 12;
+  document.getElementById('hour').value = hours;
+  document.getElementById('minute').value = now.getMinutes();
+  const ampmSelect = document.getElementById('ampm');
+  for (let i = 0; i < ampmSelect.options.length; i++) {
+    if (ampmSelect.options[i].value === ampm) {
+      ampmSelect.selectedIndex = i;
+      break;
+    }
+  }
+}
+
+document.addEventListener('DOMContentLoaded', function() {
+  // Enable the min/max or the manual brightness inputs depending on the checkbox
+  const autoBrightnessCheckbox = document.getElementById('auto_brightness');
+  const minBrightnessInput = document.getElementById('min_brightness');
+  const maxBrightnessInput = document.getElementById('max_brightness');
+  const manualBrightnessInput = document.getElementById('man_brightness');
+  function toggleBrightnessInputs() {
+    const autoEnabled = autoBrightnessCheckbox.checked;
+    minBrightnessInput.disabled = !autoEnabled;
+    maxBrightnessInput.disabled = !autoEnabled;
+    manualBrightnessInput.disabled = autoEnabled;
+  }
+  if (autoBrightnessCheckbox) {
+    autoBrightnessCheckbox.addEventListener('change', toggleBrightnessInputs);
+    toggleBrightnessInputs();
+  }
+
+  // Prefill the manual date/time picker with the browser's local time
+  const datetime = document.getElementById('datetime');
+  if (datetime) {
+    const now = new Date();
+    datetime.value = new Date(now.getTime() - now.getTimezoneOffset() * 60000).toISOString().slice(0, 16);
+  }
+
+  // Live values pushed by the clock as they change (/api/live, Server-Sent Events)
+  if (window.EventSource && document.getElementById('live')) {
+    const source = new EventSource('/api/live');
+    source.onmessage = function(event) {
+      const values = JSON.parse(event.data);
+      for (const key in values) {
+        const element = document.getElementById('live_' + key);
+        if (element) {
+          element.textContent = values[key];
+        }
+      }
+    };
+  }
+});